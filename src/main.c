@@ -1,6 +1,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <inttypes.h>
+#include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -8,162 +9,248 @@
 #include <sys/types.h>
 #include <unistd.h>
 
-#include "sim_gshare.h"
-#include "sim_hybrid.h"
+#include "sim_batch.h"
 #include "sim_io.h"
+#include "sim_log.h"
 #include "sim_math.h"
+#include "sim_parallel.h"
 #include "sim_parser.h"
+#include "sim_sample.h"
 #include "sim_simulator.h"
-#include "sim_smith_n_bit.h"
 
-// log is a macro that writes to the f if f is not NULL
-#define log(file, f, ...)                                                      \
-  if (file != NULL)                                                            \
-    fprintf(file, f, ##__VA_ARGS__);
-
-#define fatal(file, f, ...) log(file, "Fatal: " f "\n", ##__VA_ARGS__);
-#define usage(file, f, ...) log(file, "Usage: " f "\n", ##__VA_ARGS__);
-
-void help(FILE *f) {
-  log(f, "Usage: sim SIMULATION_TYPE [SIMULATION_ARGS]\n");
-  log(f, "       SIMULATION_TYPE should be one of smith, bimodal, gshare, "
-         "hybrid\n");
+// Print command line arguments.
+void print_args(int argc, char *restrict argv[], FILE *f) {
+  // Always print the program name.
+  // Then print rest of the arguments separated by a space.
+  // End with a new line.
+  fprintf(f, "%s", argv[0]);
+  for (size_t i = 1; i < argc; i++) {
+    fprintf(f, " %s", argv[i]);
+  }
+  fprintf(f, "\n");
 }
 
-enum SimSimulationType {
-  SMITH_N_BIT = 1,
-  GSHARE = 2,
-  BIMODAL = 3,
-  HYBRID = 4,
-};
-
-struct SimArgs {
-  enum SimSimulationType type;
-  uint64_t counter_bits;
-  uint64_t chooser_bits;
-  uint64_t pc_bits_1;
-  uint64_t pc_bits_2;
-  uint64_t gbhr_bits;
-  char *tracefile;
-};
-
-// Parse command line arguments.
-// A valid command line usage will identify simulator type as the first
-// argument. Additional arguments depend on the simulator type.
-int parse_args(int argc, char *restrict argv[], FILE *f, struct SimArgs *args) {
-  // Requires at least one argument to identify simulator type.
-  if (argc < 2) {
-    fatal(f, "Expect one of the simulator types as the first argument");
-    help(f);
-    return -1;
+// Run the batch mode.
+// sim batch MANIFEST_FILE [csv|json]
+int batch_main(int argc, char *argv[]) {
+  if (argc != 3 && argc != 4) {
+    fatal(stderr, "Missing required arguments for the batch mode");
+    usage(stderr, "batch MANIFEST_FILE [csv|json]");
+    return EXIT_FAILURE;
   }
-
-  if (strcmp("smith", argv[1]) == 0) {
-    // sim smith COUNTER_BITS TRACE_FILE
-    if (argc != 4) {
-      fatal(f, "Missing required arguments for the smith branch predictor");
-      usage(f, "smith COUNTER_BITS TRACE_FILE");
-      return -1;
-    }
-    int64_t counter_bits;
-    if (sim_math_strtoint64(argv[2], &counter_bits) != 0) {
-      fatal(f, "Error parsing \"%s\" as number", argv[2]);
-      return -1;
-    }
-    args->type = SMITH_N_BIT;
-    args->counter_bits = counter_bits;
-    args->tracefile = argv[3];
-  } else if (strcmp("gshare", argv[1]) == 0) {
-    // sim gshare <M1> <N> <tracefile>
-    if (argc != 5) {
-      fatal(f, "Missing required arguments for the gshare branch predictor");
-      usage(f, "gshare PC_BITS GLOBAL_BRANCH_HISTORY_REGISTER_BITS TRACE_FILE");
-      return -1;
-    }
-    int64_t pc_bits;
-    if (sim_math_strtoint64(argv[2], &pc_bits) != 0) {
-      fatal(f, "Error parsing \"%s\" as number", argv[2]);
-      return -1;
-    }
-    int64_t global_branch_history_register_bits;
-    if (sim_math_strtoint64(argv[3], &global_branch_history_register_bits) !=
-        0) {
-      fatal(f, "Error parsing \"%s\" as number", argv[3]);
-      return -1;
+  enum SimBatchFormat format = SIM_BATCH_CSV;
+  if (argc == 4) {
+    if (strcmp("json", argv[3]) == 0) {
+      format = SIM_BATCH_JSON;
+    } else if (strcmp("csv", argv[3]) != 0) {
+      fatal(stderr, "%s is not a valid batch output format", argv[3]);
+      return EXIT_FAILURE;
     }
+  }
+  if (sim_batch_run(argv[2], format, stdout, stderr) != 0) {
+    return EXIT_FAILURE;
+  }
+  return EXIT_SUCCESS;
+}
 
-    // TOOD: Handle negative case?
-    args->type = GSHARE;
-    args->pc_bits_1 = pc_bits;
-    args->gbhr_bits = global_branch_history_register_bits;
-    args->tracefile = argv[4];
-  } else if (strcmp("bimodal", argv[1]) == 0) {
-    // sim bimodal <M2> <tracefile>
-    if (argc != 4) {
-      return -1;
-    }
-    int64_t pc_bits;
-    if (sim_math_strtoint64(argv[2], &pc_bits) != 0) {
-      fatal(f, "Error parsing \"%s\" as number", argv[2]);
-      return -1;
-    }
-    args->type = BIMODAL;
-    args->pc_bits_1 = pc_bits;
-    args->tracefile = argv[3];
-  } else if (strcmp("hybrid", argv[1]) == 0) {
-    // sim hybrid <K> <M1> <N> <M2> <tracefile>
-    if (argc != 7) {
+// Parse the argument of a sample mode option into config. Counts and the seed
+// are integers, the confidence level and the early stop target are decimals.
+int parse_sample_option(int opt, char *str, struct SimSampleConfig *config) {
+  if (opt == 'c' || opt == 'e') {
+    char *end_str = NULL;
+    errno = 0;
+    double value = strtod(str, &end_str);
+    if (errno != 0 || end_str == str || *end_str != '\0' || !isfinite(value) ||
+        value < 0) {
+      fatal(stderr, "Error parsing \"%s\" as number", str);
       return -1;
     }
-    int64_t chooser_bits;
-    if (sim_math_strtoint64(argv[2], &chooser_bits) != 0) {
-      fatal(f, "Error parsing \"%s\" as number", argv[2]);
-      return -1;
-    }
-    int64_t pc_bits_1;
-    if (sim_math_strtoint64(argv[3], &pc_bits_1) != 0) {
-      fatal(f, "Error parsing \"%s\" as number", argv[3]);
-      return -1;
-    }
-    int64_t global_branch_history_register_bits;
-    if (sim_math_strtoint64(argv[4], &global_branch_history_register_bits) !=
-        0) {
-      fatal(f, "Error parsing \"%s\" as number", argv[4]);
-      return -1;
+    if (opt == 'c') {
+      config->confidence = value / 100.0;
+    } else {
+      config->target = value;
     }
-    int64_t pc_bits_2;
-    if (sim_math_strtoint64(argv[5], &pc_bits_2) != 0) {
-      fatal(f, "Error parsing \"%s\" as number", argv[5]);
-      return -1;
+    return 0;
+  }
+
+  int64_t value;
+  if (sim_math_strtoint64(str, &value) != 0 || value < 0) {
+    fatal(stderr, "Error parsing \"%s\" as non negative integer", str);
+    return -1;
+  }
+  switch (opt) {
+  case 'u':
+    config->interval = value;
+    break;
+  case 'w':
+    config->warmup = value;
+    break;
+  case 'p':
+    config->period = value;
+    config->samples = 0;
+    break;
+  case 'r':
+    config->samples = value;
+    break;
+  case 's':
+    config->seed = value;
+    break;
+  }
+  return 0;
+}
+
+// Run the sample mode.
+// sim sample [-u INTERVAL] [-w WARMUP] [-p PERIOD | -r SAMPLES]
+//            [-c CONFIDENCE] [-e TARGET] [-s SEED] SIMULATION_TYPE ...
+int sample_main(int argc, char *argv[]) {
+  struct SimSampleConfig config;
+  sim_sample_config_init(&config);
+
+  // Skip "sim" so that getopt starts at the sample mode options and stops at
+  // the simulation type.
+  argc--;
+  argv++;
+  optind = 1;
+  int opt;
+  bool has_period = false;
+  bool has_samples = false;
+  while ((opt = getopt(argc, argv, "+u:w:p:r:c:e:s:")) != -1) {
+    if (opt == '?' || parse_sample_option(opt, optarg, &config) != 0) {
+      usage(stderr, "sample [-u INTERVAL] [-w WARMUP] [-p PERIOD | -r SAMPLES] "
+                    "[-c CONFIDENCE_PERCENT] [-e TARGET_PERCENT] [-s SEED] "
+                    "SIMULATION_TYPE [SIMULATION_ARGS]");
+      return EXIT_FAILURE;
     }
-    args->type = HYBRID;
-    args->chooser_bits = chooser_bits;
-    args->pc_bits_1 = pc_bits_1;
-    args->gbhr_bits = global_branch_history_register_bits;
-    args->pc_bits_2 = pc_bits_2;
-    args->tracefile = argv[6];
+    has_period = has_period || opt == 'p';
+    has_samples = has_samples || opt == 'r';
+  }
+  if (has_period && has_samples) {
+    fatal(stderr, "Only one of -p and -r can be used");
+    return EXIT_FAILURE;
+  }
+  if (config.period == 0 || (has_samples && config.samples == 0)) {
+    fatal(stderr, "Period and number of samples must be positive");
+    return EXIT_FAILURE;
+  }
+  if (config.interval == 0 || config.confidence <= 0 ||
+      config.confidence >= 1) {
+    fatal(stderr, "Interval must be positive and confidence within (0, 100)");
+    return EXIT_FAILURE;
+  }
+
+  // The last option plays the program name for the simulator arguments.
+  struct SimArgs args;
+  if (sim_simulator_parse_args(argc - optind + 1, argv + optind - 1, stderr,
+                               &args) != 0 ||
+      args.type == 0) {
+    return EXIT_FAILURE;
+  }
+
+  printf("COMMAND\n");
+  print_args(argc + 1, argv - 1, stdout);
+
+  struct SimSampleResult result;
+  if (sim_sample_run(&config, &args, &result) != 0) {
+    fprintf(stderr, "Error running sampled simulation of \"%s\"\n",
+            args.tracefile);
+    return EXIT_FAILURE;
+  }
+
+  fprintf(stdout, "OUTPUT\n");
+  fprintf(stdout, "number of predictions: \t%" PRIu64 "\n",
+          result.total_predictions);
+  fprintf(stdout, "number of sampled intervals:\t%" PRIu64 " of %" PRIu64 "\n",
+          result.measured, result.intervals);
+  fprintf(stdout, "number of sampled predictions:\t%" PRIu64 "\n",
+          result.predictions);
+  fprintf(stdout, "number of sampled mispredictions:\t%" PRIu64 "\n",
+          result.mispredictions);
+  fprintf(stdout, "misprediction rate:\t\t%.2f%%\n", result.rate);
+  // The spread of interval rates, and so the interval, needs two samples.
+  if (result.measured < 2) {
+    fprintf(stdout, "confidence interval:\t\tn/a (needs at least 2 sampled "
+                    "intervals)\n");
   } else {
-    log(f, "%s is not a valid simulation type\n", argv[1]);
+    fprintf(stdout,
+            "confidence interval:\t\t+/- %.2f%% (%.0f%% confidence)\n",
+            result.half_width, config.confidence * 100.0);
   }
+  return EXIT_SUCCESS;
+}
 
-  return 0;
+// Print simulation results in the format of the sequential simulator.
+void print_output(struct SimSimulator *s, uint64_t total_predictions,
+                  uint64_t mis_predictions, FILE *f) {
+  fprintf(f, "OUTPUT\n");
+  fprintf(f, "number of predictions: \t%" PRIu64 "\n", total_predictions);
+  fprintf(f, "number of mispredictions:\t%" PRIu64 "\n", mis_predictions);
+  fprintf(f, "misprediction rate:\t\t%.2f%%\n",
+          (mis_predictions * 100.0) / total_predictions);
+  sim_simulator_print(s, f);
 }
 
-// Print command line arguments.
-void print_args(int argc, char *restrict argv[], FILE *f) {
-  // Always print the program name.
-  // Then print rest of the arguments separated by a space.
-  // End with a new line.
-  fprintf(f, "%s", argv[0]);
-  for (size_t i = 1; i < argc; i++) {
-    fprintf(f, " %s", argv[i]);
+// Run the parallel mode. Only bimodal and gshare can be simulated in parallel.
+// sim parallel [-t THREADS] gshare|bimodal [SIMULATION_ARGS]
+int parallel_main(int argc, char *argv[]) {
+  // Skip "sim" so that getopt starts at the parallel mode options and stops at
+  // the simulation type.
+  argc--;
+  argv++;
+  optind = 1;
+  int opt;
+  int64_t threads = 0;
+  while ((opt = getopt(argc, argv, "+t:")) != -1) {
+    if (opt == '?' || sim_math_strtoint64(optarg, &threads) != 0 ||
+        threads < 0) {
+      usage(stderr, "parallel [-t THREADS] gshare|bimodal [SIMULATION_ARGS]");
+      return EXIT_FAILURE;
+    }
   }
-  fprintf(f, "\n");
+
+  // The last option plays the program name for the simulator arguments.
+  struct SimArgs args;
+  if (sim_simulator_parse_args(argc - optind + 1, argv + optind - 1, stderr,
+                               &args) != 0) {
+    return EXIT_FAILURE;
+  }
+  if (args.type != GSHARE && args.type != BIMODAL) {
+    fatal(stderr, "Parallel mode only supports gshare and bimodal");
+    return EXIT_FAILURE;
+  }
+
+  struct SimSimulator simulator;
+  if (sim_simulator_init(&simulator, &args) != 0) {
+    fprintf(stderr, "Error initializing the branch predictor\n");
+    return EXIT_FAILURE;
+  }
+  uint64_t total_predictions = 0;
+  uint64_t mis_predictions = 0;
+  if (sim_parallel_gshare_run(&simulator.gshare, args.tracefile, threads,
+                              &total_predictions, &mis_predictions) != 0) {
+    fprintf(stderr, "Error running parallel simulation of \"%s\"\n",
+            args.tracefile);
+    sim_simulator_free(&simulator);
+    return EXIT_FAILURE;
+  }
+
+  printf("COMMAND\n");
+  print_args(argc + 1, argv - 1, stdout);
+  print_output(&simulator, total_predictions, mis_predictions, stdout);
+  sim_simulator_free(&simulator);
+  return EXIT_SUCCESS;
 }
 
 int main(int argc, char *argv[]) {
+  if (argc >= 2 && strcmp("batch", argv[1]) == 0) {
+    return batch_main(argc, argv);
+  } else if (argc >= 2 && strcmp("sample", argv[1]) == 0) {
+    return sample_main(argc, argv);
+  } else if (argc >= 2 && strcmp("parallel", argv[1]) == 0) {
+    return parallel_main(argc, argv);
+  }
+
   struct SimArgs args;
-  int status = parse_args(argc, argv, stderr, &args);
+  int status = sim_simulator_parse_args(argc, argv, stderr, &args);
   if (status != 0) {
     return status;
   }
@@ -179,20 +266,9 @@ int main(int argc, char *argv[]) {
   printf("COMMAND\n");
   print_args(argc, argv, stdout);
 
-  struct SimSmithNBit smith_n_bit;
-  struct SimGshare gshare;
-  struct SimHybrid hybrid;
-  if (args.type == SMITH_N_BIT) {
-    sim_smith_n_bit_init(&smith_n_bit, args.counter_bits);
-  } else if (args.type == GSHARE) {
-    sim_gshare_init(&gshare, args.gbhr_bits, args.pc_bits_1, 3);
-  } else if (args.type == BIMODAL) {
-    sim_gshare_init(&gshare, 0, args.pc_bits_1, 3);
-  } else if (args.type == HYBRID) {
-    sim_hybrid_init(&hybrid, args.chooser_bits, args.gbhr_bits, args.pc_bits_1,
-                    args.pc_bits_2, 2, 1);
-  } else {
-    fprintf(stderr, "Invalid simulation type\n");
+  struct SimSimulator simulator;
+  if (sim_simulator_init(&simulator, &args) != 0) {
+    fprintf(stderr, "Error initializing the branch predictor\n");
     return EXIT_FAILURE;
   }
 
@@ -209,20 +285,8 @@ int main(int argc, char *argv[]) {
   uint64_t parse_status = 0;
   while ((parse_status = sim_parser_next_token(&parser, &inst)) > 0) {
     total_predictions++;
-    bool prediction = false;
+    bool prediction = sim_simulator_predict_and_update(&simulator, &inst);
     bool outcome = inst.taken;
-    if (args.type == SMITH_N_BIT) {
-      prediction = sim_smith_n_bit_predict_and_update(&smith_n_bit, &inst);
-    } else if (args.type == GSHARE) {
-      prediction = sim_gshare_predict_and_update(&gshare, &inst);
-    } else if (args.type == BIMODAL) {
-      prediction = sim_gshare_predict_and_update(&gshare, &inst);
-    } else if (args.type == HYBRID) {
-      prediction = sim_hybrid_predict_and_update(&hybrid, &inst);
-    } else {
-      fprintf(stderr, "Assertion failure: Invalid branch predictor type: %d\n", args.type);
-      return EXIT_FAILURE;
-    }
     if (prediction != outcome) {
       mis_predictions++;
     }
@@ -230,26 +294,8 @@ int main(int argc, char *argv[]) {
   close(fd);
   sim_read_buf_free(&parser.buf);
 
-  fprintf(stdout, "OUTPUT\n");
-  fprintf(stdout, "number of predictions: \t%" PRIu64 "\n", total_predictions);
-  fprintf(stdout, "number of mispredictions:\t%" PRIu64 "\n", mis_predictions);
-  fprintf(stdout, "misprediction rate:\t\t%.2f%%\n",
-          (mis_predictions * 100.0) / total_predictions);
-  if (args.type == SMITH_N_BIT) {
-    sim_smith_n_bit_print(&smith_n_bit, stdout);
-  } else if (args.type == GSHARE) {
-    sim_gshare_print(&gshare, stdout);
-    sim_gshare_free(&gshare);
-  } else if (args.type == BIMODAL) {
-    sim_gshare_print(&gshare, stdout);
-    sim_gshare_free(&gshare);
-  } else if (args.type == HYBRID) {
-    sim_hybrid_print(&hybrid, stdout);
-    sim_hybrid_free(&hybrid);
-  } else {
-    fprintf(stderr, "Assertion failure: Invalid branch predictor type: %d\n", args.type);
-    return EXIT_FAILURE;
-  }
+  print_output(&simulator, total_predictions, mis_predictions, stdout);
+  sim_simulator_free(&simulator);
 
   if (parse_status != 0) {
     return EXIT_FAILURE;
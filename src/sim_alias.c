@@ -0,0 +1,179 @@
+#include "sim_alias.h"
+#include <inttypes.h>
+#include <stdlib.h>
+
+#define SIM_ALIAS_TAGS_INITIAL_CAPACITY 1024
+
+struct SimAliasTag {
+  int64_t address;
+  uint64_t history;
+  size_t index;
+  uint64_t counter;
+  bool used;
+};
+
+int sim_alias_stats_init(struct SimAliasStats *stats, size_t entries,
+                         uint64_t counter_max,
+                         uint64_t counter_taken_threshold) {
+  stats->entries = entries;
+  stats->last_address = calloc(entries, sizeof(int64_t));
+  stats->last_history = calloc(entries, sizeof(uint64_t));
+  stats->occupied = calloc(entries, sizeof(bool));
+  stats->sharers = calloc(entries, sizeof(uint64_t));
+
+  stats->tags_size = 0;
+  stats->tags_capacity = SIM_ALIAS_TAGS_INITIAL_CAPACITY;
+  stats->tags = calloc(stats->tags_capacity, sizeof(struct SimAliasTag));
+  if (stats->last_address == NULL || stats->last_history == NULL ||
+      stats->occupied == NULL || stats->sharers == NULL ||
+      stats->tags == NULL) {
+    sim_alias_stats_free(stats);
+    return -1;
+  }
+
+  stats->accesses = 0;
+  stats->aliasing = 0;
+  stats->constructive = 0;
+  stats->destructive = 0;
+  stats->neutral = 0;
+
+  stats->_counter_max = counter_max;
+  stats->_counter_taken_threshold = counter_taken_threshold;
+  return 0;
+}
+
+void sim_alias_stats_free(struct SimAliasStats *stats) {
+  free(stats->last_address);
+  free(stats->last_history);
+  free(stats->occupied);
+  free(stats->sharers);
+  free(stats->tags);
+  stats->entries = 0;
+  stats->tags_size = 0;
+  stats->tags_capacity = 0;
+}
+
+static size_t sim_alias_tag_hash(int64_t address, uint64_t history,
+                                 size_t index) {
+  // splitmix64 finalizer over the combined tag.
+  uint64_t x = (uint64_t)address ^ (history * UINT64_C(0x9e3779b97f4a7c15)) ^
+               ((uint64_t)index << 32);
+  x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return x ^ (x >> 31);
+}
+
+// Find slot of the tag in a table whose capacity is a power of 2. The index is
+// part of the key: a history longer than 64 outcomes is folded, so the same
+// address and folded history may still reach different entries.
+static struct SimAliasTag *sim_alias_tag_slot(struct SimAliasTag *tags,
+                                              size_t capacity, int64_t address,
+                                              uint64_t history, size_t index) {
+  size_t i = sim_alias_tag_hash(address, history, index) & (capacity - 1);
+  while (tags[i].used &&
+         (tags[i].address != address || tags[i].history != history ||
+          tags[i].index != index)) {
+    i = (i + 1) & (capacity - 1);
+  }
+  return &tags[i];
+}
+
+static void sim_alias_tags_grow(struct SimAliasStats *stats) {
+  size_t capacity = stats->tags_capacity * 2;
+  struct SimAliasTag *tags = calloc(capacity, sizeof(struct SimAliasTag));
+  if (tags == NULL) {
+    // Keep probing the current table. It still has free slots.
+    return;
+  }
+  for (size_t i = 0; i < stats->tags_capacity; i++) {
+    struct SimAliasTag *t = &stats->tags[i];
+    if (t->used) {
+      *sim_alias_tag_slot(tags, capacity, t->address, t->history, t->index) =
+          *t;
+    }
+  }
+  free(stats->tags);
+  stats->tags = tags;
+  stats->tags_capacity = capacity;
+}
+
+void sim_alias_stats_record(struct SimAliasStats *stats, int64_t address,
+                            uint64_t history, size_t index, bool prediction,
+                            bool taken) {
+  // Keep load factor at or below 1/2.
+  if ((stats->tags_size + 1) * 2 > stats->tags_capacity) {
+    sim_alias_tags_grow(stats);
+  }
+  struct SimAliasTag *tag = sim_alias_tag_slot(
+      stats->tags, stats->tags_capacity, address, history, index);
+  if (!tag->used) {
+    tag->used = true;
+    tag->address = address;
+    tag->history = history;
+    tag->index = index;
+    tag->counter = stats->_counter_taken_threshold;
+    stats->tags_size++;
+    stats->sharers[index]++;
+  }
+
+  stats->accesses++;
+  if (stats->occupied[index] && (stats->last_address[index] != address ||
+                                 stats->last_history[index] != history)) {
+    stats->aliasing++;
+    bool private_prediction = tag->counter >= stats->_counter_taken_threshold;
+    bool shared_correct = prediction == taken;
+    bool private_correct = private_prediction == taken;
+    if (shared_correct && !private_correct) {
+      stats->constructive++;
+    } else if (!shared_correct && private_correct) {
+      stats->destructive++;
+    } else {
+      stats->neutral++;
+    }
+  }
+  stats->occupied[index] = true;
+  stats->last_address[index] = address;
+  stats->last_history[index] = history;
+
+  if (taken) {
+    if (tag->counter < stats->_counter_max) {
+      tag->counter++;
+    }
+  } else {
+    if (tag->counter > 0) {
+      tag->counter--;
+    }
+  }
+}
+
+void sim_alias_stats_print(struct SimAliasStats *stats, const char *name,
+                           FILE *f) {
+  uint64_t occupied = 0;
+  uint64_t max_sharers = 0;
+  for (size_t i = 0; i < stats->entries; i++) {
+    if (stats->occupied[i]) {
+      occupied++;
+    }
+    if (stats->sharers[i] > max_sharers) {
+      max_sharers = stats->sharers[i];
+    }
+  }
+
+  fprintf(f, "%s ALIASING\n", name);
+  fprintf(f, "table entries:\t\t\t%zu\n", stats->entries);
+  fprintf(f, "occupied entries:\t\t%" PRIu64 " (%.2f%%)\n", occupied,
+          stats->entries > 0 ? (occupied * 100.0) / stats->entries : 0.0);
+  fprintf(f, "distinct tags:\t\t\t%zu\n", stats->tags_size);
+  fprintf(f, "max sharers per entry:\t\t%" PRIu64 "\n", max_sharers);
+  fprintf(f, "mean sharers per occupied entry:\t%.2f\n",
+          occupied > 0 ? (double)stats->tags_size / occupied : 0.0);
+  fprintf(f, "accesses:\t\t\t%" PRIu64 "\n", stats->accesses);
+  fprintf(f, "aliasing accesses:\t\t%" PRIu64 "\n", stats->aliasing);
+  fprintf(f, "constructive aliasing:\t\t%" PRIu64 "\n", stats->constructive);
+  fprintf(f, "destructive aliasing:\t\t%" PRIu64 "\n", stats->destructive);
+  fprintf(f, "neutral aliasing:\t\t%" PRIu64 "\n", stats->neutral);
+  fprintf(f, "%s ENTRY SHARERS\n", name);
+  for (size_t i = 0; i < stats->entries; i++) {
+    fprintf(f, "%zu %" PRIu64 "\n", i, stats->sharers[i]);
+  }
+}
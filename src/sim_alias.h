@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * SimAliasStats instruments aliasing in a prediction table. It is only
+ * compiled in when SIM_ALIAS_STATS is defined (make ALIAS_STATS=1).
+ *
+ * A table access is tagged with the branch address and the global history used
+ * to form its index. The history is tracked uncompressed for up to 64 outcomes,
+ * so histories that gshare folds onto the same index bits still get distinct
+ * tags. Longer histories are folded to 64 bits, and histories that only differ
+ * in a way that folding cancels out share a tag. An aliasing event is an access
+ * to an entry that was last trained by a different tag. Every tag also trains a
+ * private, interference free counter. An aliasing event is constructive when
+ * only the shared counter predicts correctly, destructive when only the private
+ * counter does, and neutral otherwise.
+ * @var entries Number of entries in the instrumented table.
+ * @var last_address Address of the tag that last trained each entry.
+ * @var last_history History of the tag that last trained each entry.
+ * @var occupied Whether each entry has been trained at all.
+ * @var sharers Number of distinct tags that trained each entry.
+ * @var tags Open addressing hash table of tags seen so far.
+ */
+struct SimAliasStats {
+  size_t entries;
+  int64_t *last_address;
+  uint64_t *last_history;
+  bool *occupied;
+  uint64_t *sharers;
+
+  struct SimAliasTag *tags;
+  size_t tags_size;
+  size_t tags_capacity;
+
+  uint64_t accesses;
+  uint64_t aliasing;
+  uint64_t constructive;
+  uint64_t destructive;
+  uint64_t neutral;
+
+  uint64_t _counter_max;
+  uint64_t _counter_taken_threshold;
+};
+
+/**
+ * Initialize alias statistics for a table.
+ * @param[in] stats Uninitialized SimAliasStats.
+ * @param[in] entries Number of entries in the table.
+ * @param[in] counter_max Maximum value of the table's counters.
+ * @param[in] counter_taken_threshold Counter value from which taken is
+ *            predicted. Also the initial counter value.
+ * @return 0 if initialization is successful.
+ *        -1 if memory allocation fails.
+ */
+int sim_alias_stats_init(struct SimAliasStats *stats, size_t entries,
+                          uint64_t counter_max,
+                          uint64_t counter_taken_threshold);
+void sim_alias_stats_free(struct SimAliasStats *stats);
+
+/**
+ * Record a training access to the table. Call it before the table is updated.
+ * @param[in] stats Initialized SimAliasStats.
+ * @param[in] address Branch address.
+ * @param[in] history Global history used to compute the index.
+ * @param[in] index Table index accessed.
+ * @param[in] prediction Prediction made by the shared table entry.
+ * @param[in] taken Actual outcome of the branch.
+ */
+void sim_alias_stats_record(struct SimAliasStats *stats, int64_t address,
+                            uint64_t history, size_t index, bool prediction,
+                            bool taken);
+
+/**
+ * Print alias statistics followed by the sharer count of every entry.
+ * @param[in] stats Initialized SimAliasStats.
+ * @param[in] name Name of the table, e.g. GSHARE.
+ * @param[in] f File to print to.
+ */
+void sim_alias_stats_print(struct SimAliasStats *stats, const char *name,
+                           FILE *f);
@@ -0,0 +1,416 @@
+#include "sim_batch.h"
+#include "sim_log.h"
+#include "sim_math.h"
+#include "sim_simulator.h"
+#include "sim_thread_pool.h"
+#include "sim_trace.h"
+#include <glob.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// Maximum number of whitespace separated tokens on a manifest line.
+#define SIM_BATCH_MAX_TOKENS 16
+#define SIM_BATCH_LABEL_SIZE 128
+
+// SimBatchTrace is a trace file of the manifest. It is decoded by its load job
+// and freed by whichever of its simulation jobs finishes last.
+struct SimBatchTrace {
+  char *path;
+  uint64_t file_size;
+  struct SimTrace trace;
+  int status;
+  pthread_mutex_t lock;
+  size_t remaining_jobs;
+};
+
+struct SimBatchConfig {
+  struct SimArgs args;
+  char label[SIM_BATCH_LABEL_SIZE];
+};
+
+struct SimBatchJob {
+  struct SimBatchTrace *trace;
+  struct SimBatchConfig *config;
+  uint64_t predictions;
+  uint64_t mispredictions;
+  int status;
+};
+
+struct SimBatchManifest {
+  size_t threads;
+  struct SimBatchTrace *traces;
+  size_t traces_size;
+  size_t traces_capacity;
+  struct SimBatchConfig *configs;
+  size_t configs_size;
+  size_t configs_capacity;
+};
+
+// Grow array to hold at least one more element.
+static int sim_batch_reserve(void **array, size_t *capacity, size_t size,
+                             size_t element_size) {
+  if (size < *capacity) {
+    return 0;
+  }
+  size_t new_capacity = *capacity == 0 ? 8 : *capacity * 2;
+  void *new_array = realloc(*array, new_capacity * element_size);
+  if (new_array == NULL) {
+    return -1;
+  }
+  *array = new_array;
+  *capacity = new_capacity;
+  return 0;
+}
+
+static int sim_batch_add_traces(struct SimBatchManifest *m, const char *pattern,
+                                FILE *err) {
+  glob_t g;
+  int status = glob(pattern, 0, NULL, &g);
+  if (status == GLOB_NOMATCH) {
+    fatal(err, "No trace file matches \"%s\"", pattern);
+    return -1;
+  } else if (status != 0) {
+    fatal(err, "Error expanding \"%s\"", pattern);
+    return -1;
+  }
+
+  for (size_t i = 0; i < g.gl_pathc; i++) {
+    if (sim_batch_reserve((void **)&m->traces, &m->traces_capacity,
+                          m->traces_size, sizeof(struct SimBatchTrace)) < 0) {
+      globfree(&g);
+      return -1;
+    }
+    struct SimBatchTrace *t = &m->traces[m->traces_size];
+    struct stat st;
+    t->path = strdup(g.gl_pathv[i]);
+    t->file_size = stat(g.gl_pathv[i], &st) == 0 ? (uint64_t)st.st_size : 0;
+    t->status = -1;
+    if (t->path == NULL) {
+      globfree(&g);
+      return -1;
+    }
+    pthread_mutex_init(&t->lock, NULL);
+    t->remaining_jobs = 0;
+    m->traces_size++;
+  }
+  globfree(&g);
+  return 0;
+}
+
+static int sim_batch_add_config(struct SimBatchManifest *m, int argc,
+                                char *argv[], FILE *err) {
+  if (sim_batch_reserve((void **)&m->configs, &m->configs_capacity,
+                        m->configs_size, sizeof(struct SimBatchConfig)) < 0) {
+    return -1;
+  }
+  // Simulator arguments end with the trace file, which comes from the trace
+  // lines instead. Append a placeholder so the command line parser applies.
+  argv[argc++] = "TRACE_FILE";
+  struct SimBatchConfig *c = &m->configs[m->configs_size];
+  if (sim_simulator_parse_args(argc, argv, err, &c->args) != 0) {
+    return -1;
+  }
+  if (c->args.type == 0) {
+    return -1;
+  }
+  sim_simulator_format_args(&c->args, c->label, sizeof(c->label));
+  m->configs_size++;
+  return 0;
+}
+
+static int sim_batch_parse_manifest(struct SimBatchManifest *m,
+                                    const char *path, FILE *err) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    fatal(err, "Error reading manifest file \"%s\"", path);
+    return -1;
+  }
+
+  int status = 0;
+  char *line = NULL;
+  size_t line_capacity = 0;
+  size_t line_number = 0;
+  while (status == 0 && getline(&line, &line_capacity, f) >= 0) {
+    line_number++;
+    // One slot is kept free for the placeholder trace file of config lines.
+    char *argv[SIM_BATCH_MAX_TOKENS + 1];
+    int argc = 0;
+    char *save = NULL;
+    for (char *tok = strtok_r(line, " \t\r\n", &save); tok != NULL;
+         tok = strtok_r(NULL, " \t\r\n", &save)) {
+      if (argc == SIM_BATCH_MAX_TOKENS) {
+        argc = -1;
+        break;
+      }
+      argv[argc++] = tok;
+    }
+
+    if (argc == 0 || argv[0][0] == '#') {
+      continue;
+    } else if (argc < 0) {
+      fatal(err, "%s:%zu: Too many arguments", path, line_number);
+      status = -1;
+    } else if (strcmp("trace", argv[0]) == 0 && argc == 2) {
+      status = sim_batch_add_traces(m, argv[1], err);
+    } else if (strcmp("config", argv[0]) == 0 && argc >= 2) {
+      status = sim_batch_add_config(m, argc, argv, err);
+      if (status != 0) {
+        fatal(err, "%s:%zu: Invalid predictor configuration", path,
+              line_number);
+      }
+    } else if (strcmp("threads", argv[0]) == 0 && argc == 2) {
+      int64_t threads;
+      if (sim_math_strtoint64(argv[1], &threads) != 0 || threads < 0) {
+        fatal(err, "%s:%zu: Error parsing \"%s\" as number", path,
+              line_number, argv[1]);
+        status = -1;
+      } else {
+        m->threads = threads;
+      }
+    } else {
+      fatal(err, "%s:%zu: Unknown manifest entry \"%s\"", path, line_number,
+            argv[0]);
+      status = -1;
+    }
+  }
+  free(line);
+  fclose(f);
+  return status;
+}
+
+static void sim_batch_manifest_free(struct SimBatchManifest *m) {
+  for (size_t i = 0; i < m->traces_size; i++) {
+    free(m->traces[i].path);
+    if (m->traces[i].status == 0) {
+      sim_trace_free(&m->traces[i].trace);
+    }
+    pthread_mutex_destroy(&m->traces[i].lock);
+  }
+  free(m->traces);
+  free(m->configs);
+}
+
+static void sim_batch_load_trace(void *arg) {
+  struct SimBatchTrace *t = arg;
+  t->status = sim_trace_load(&t->trace, t->path);
+}
+
+// Relative cost of simulating one branch with a predictor, measured on a
+// decoded trace. Hybrid updates two predictors and a chooser table.
+static uint64_t sim_batch_config_weight(const struct SimBatchConfig *c) {
+  switch (c->args.type) {
+  case SMITH_N_BIT:
+    return 2;
+  case BIMODAL:
+  case GSHARE:
+    return 3;
+  case HYBRID:
+    return 7;
+  }
+  return 1;
+}
+
+// Release the decoded trace once its last simulation job is done with it, so
+// that only traces with jobs still running stay in memory.
+static void sim_batch_release_trace(struct SimBatchTrace *t) {
+  pthread_mutex_lock(&t->lock);
+  if (--t->remaining_jobs == 0 && t->status == 0) {
+    sim_trace_free(&t->trace);
+  }
+  pthread_mutex_unlock(&t->lock);
+}
+
+static void sim_batch_simulate(void *arg) {
+  struct SimBatchJob *job = arg;
+  struct SimSimulator s;
+  if (job->trace->status != 0 ||
+      sim_simulator_init(&s, &job->config->args) != 0) {
+    job->status = -1;
+    sim_batch_release_trace(job->trace);
+    return;
+  }
+
+  struct SimTrace *trace = &job->trace->trace;
+  uint64_t mis_predictions = 0;
+  for (size_t i = 0; i < trace->size; i++) {
+    struct SimInstruction *inst = &trace->instructions[i];
+    if (sim_simulator_predict_and_update(&s, inst) != inst->taken) {
+      mis_predictions++;
+    }
+  }
+  sim_simulator_free(&s);
+
+  job->predictions = trace->size;
+  job->mispredictions = mis_predictions;
+  job->status = 0;
+  sim_batch_release_trace(job->trace);
+}
+
+static void sim_batch_print_csv_string(FILE *f, const char *str) {
+  if (strpbrk(str, ",\"\r\n") == NULL) {
+    fputs(str, f);
+    return;
+  }
+  fputc('"', f);
+  for (const char *c = str; *c != '\0'; c++) {
+    if (*c == '"') {
+      fputc('"', f);
+    }
+    fputc(*c, f);
+  }
+  fputc('"', f);
+}
+
+static void sim_batch_print_json_string(FILE *f, const char *str) {
+  fputc('"', f);
+  for (const char *c = str; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      fprintf(f, "\\%c", *c);
+    } else if ((unsigned char)*c < 0x20) {
+      fprintf(f, "\\u%04x", (unsigned char)*c);
+    } else {
+      fputc(*c, f);
+    }
+  }
+  fputc('"', f);
+}
+
+static double sim_batch_misprediction_rate(struct SimBatchJob *job) {
+  if (job->predictions == 0) {
+    return 0.0;
+  }
+  return (job->mispredictions * 100.0) / job->predictions;
+}
+
+static void sim_batch_print_csv(FILE *f, struct SimBatchJob *jobs,
+                                size_t count) {
+  fprintf(f, "trace,config,predictions,mispredictions,misprediction_rate\n");
+  for (size_t i = 0; i < count; i++) {
+    if (jobs[i].status != 0) {
+      continue;
+    }
+    sim_batch_print_csv_string(f, jobs[i].trace->path);
+    fputc(',', f);
+    sim_batch_print_csv_string(f, jobs[i].config->label);
+    fprintf(f, ",%" PRIu64 ",%" PRIu64 ",%.2f\n", jobs[i].predictions,
+            jobs[i].mispredictions, sim_batch_misprediction_rate(&jobs[i]));
+  }
+}
+
+static void sim_batch_print_json(FILE *f, struct SimBatchJob *jobs,
+                                 size_t count) {
+  fprintf(f, "[");
+  bool first = true;
+  for (size_t i = 0; i < count; i++) {
+    if (jobs[i].status != 0) {
+      continue;
+    }
+    fprintf(f, first ? "\n" : ",\n");
+    first = false;
+    fprintf(f, "  {\"trace\": ");
+    sim_batch_print_json_string(f, jobs[i].trace->path);
+    fprintf(f, ", \"config\": ");
+    sim_batch_print_json_string(f, jobs[i].config->label);
+    fprintf(f,
+            ", \"predictions\": %" PRIu64 ", \"mispredictions\": %" PRIu64
+            ", \"misprediction_rate\": %.2f}",
+            jobs[i].predictions, jobs[i].mispredictions,
+            sim_batch_misprediction_rate(&jobs[i]));
+  }
+  fprintf(f, "\n]\n");
+}
+
+int sim_batch_run(const char *manifest, enum SimBatchFormat format, FILE *out,
+                  FILE *err) {
+  struct SimBatchManifest m = {0};
+  if (sim_batch_parse_manifest(&m, manifest, err) != 0) {
+    sim_batch_manifest_free(&m);
+    return -1;
+  }
+
+  if (m.traces_size == 0 || m.configs_size == 0) {
+    fatal(err, "Manifest \"%s\" needs at least one trace and one config",
+          manifest);
+    sim_batch_manifest_free(&m);
+    return -1;
+  }
+
+  // Each trace has a load job followed by one simulation job per config.
+  // Simulation jobs only become runnable once their trace is decoded, and the
+  // pool runs them before the worker decodes another trace, so traces are
+  // decoded as they are needed rather than all up front.
+  size_t count = m.traces_size * m.configs_size;
+  struct SimJob *pool_jobs =
+      malloc((m.traces_size + count) * sizeof(struct SimJob));
+  struct SimJob **dependents = malloc(count * sizeof(struct SimJob *));
+  struct SimBatchJob *jobs = malloc(count * sizeof(struct SimBatchJob));
+  if (pool_jobs == NULL || dependents == NULL || jobs == NULL) {
+    fatal(err, "Error allocating batch jobs");
+    free(pool_jobs);
+    free(dependents);
+    free(jobs);
+    sim_batch_manifest_free(&m);
+    return -1;
+  }
+
+  // The file size stands in for the number of branches, which is only known
+  // once the trace is decoded. Loading a trace costs as much as all of its
+  // simulations, so the traces with the most work are decoded first.
+  struct SimJob *simulate_jobs = pool_jobs + m.traces_size;
+  for (size_t t = 0; t < m.traces_size; t++) {
+    uint64_t trace_cost = 0;
+    for (size_t c = 0; c < m.configs_size; c++) {
+      size_t i = t * m.configs_size + c;
+      uint64_t cost =
+          m.traces[t].file_size * sim_batch_config_weight(&m.configs[c]);
+      jobs[i] = (struct SimBatchJob){
+          .trace = &m.traces[t], .config = &m.configs[c], .status = -1};
+      simulate_jobs[i] = (struct SimJob){
+          .run = sim_batch_simulate, .arg = &jobs[i], .cost = cost};
+      dependents[i] = &simulate_jobs[i];
+      trace_cost += cost;
+    }
+    m.traces[t].remaining_jobs = m.configs_size;
+    pool_jobs[t] =
+        (struct SimJob){.run = sim_batch_load_trace,
+                        .arg = &m.traces[t],
+                        .cost = trace_cost,
+                        .dependents = &dependents[t * m.configs_size],
+                        .dependents_size = m.configs_size};
+  }
+
+  int status = 0;
+  if (sim_thread_pool_run(pool_jobs, m.traces_size + count, m.threads) != 0) {
+    fatal(err, "Error starting batch jobs");
+    status = -1;
+  } else {
+    for (size_t t = 0; t < m.traces_size; t++) {
+      if (m.traces[t].status != 0) {
+        fatal(err, "Error reading trace file \"%s\"", m.traces[t].path);
+        status = -1;
+      }
+    }
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (jobs[i].status != 0) {
+      status = -1;
+    }
+  }
+
+  if (format == SIM_BATCH_JSON) {
+    sim_batch_print_json(out, jobs, count);
+  } else {
+    sim_batch_print_csv(out, jobs, count);
+  }
+
+  free(pool_jobs);
+  free(dependents);
+  free(jobs);
+  sim_batch_manifest_free(&m);
+  return status;
+}
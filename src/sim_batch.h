@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdio.h>
+
+enum SimBatchFormat {
+  SIM_BATCH_CSV = 1,
+  SIM_BATCH_JSON = 2,
+};
+
+/**
+ * Run every trace listed in the manifest against every predictor configuration
+ * listed in it and write one aggregated report.
+ *
+ * Manifest files are line oriented. Blank lines and lines starting with # are
+ * ignored. Other lines are one of
+ *   trace GLOB_PATTERN          Trace files to simulate. May repeat.
+ *   config SIMULATION_TYPE ...  Simulator arguments without the trace file,
+ *                               e.g. "config gshare 9 3". May repeat.
+ *   threads N                   Worker threads. Defaults to online CPUs.
+ *
+ * Each trace is decoded once and shared read-only by all of its jobs. Jobs run
+ * on a work-stealing thread pool, longest traces first. Results are reported
+ * in manifest order: by trace, then by configuration.
+ * @param[in] manifest Path of the manifest file.
+ * @param[in] format Output format of the report.
+ * @param[in] out File to write the report to.
+ * @param[in] err File to report errors to. May be NULL.
+ * @return 0 if every job ran successfully.
+ *        -1 otherwise.
+ */
+int sim_batch_run(const char *manifest, enum SimBatchFormat format, FILE *out,
+                  FILE *err);
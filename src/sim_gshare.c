@@ -6,7 +6,7 @@
 #include <stdio.h>
 #include <inttypes.h>
 
-void sim_gshare_init(struct SimGshare *gs, uint64_t n, uint64_t m, uint64_t counter_bits) {
+int sim_gshare_init(struct SimGshare *gs, uint64_t n, uint64_t m, uint64_t counter_bits) {
   gs->n = n;
   gs->m = m;
 
@@ -15,6 +15,10 @@ void sim_gshare_init(struct SimGshare *gs, uint64_t n, uint64_t m, uint64_t coun
 
   gs->global_bhr = 0;
   gs->prediction_table = malloc(two_pow_m * sizeof(uint64_t));
+  gs->_history = NULL;
+  if (gs->prediction_table == NULL) {
+    return -1;
+  }
 
   gs->_counter_max = two_pow_counter_bits - 1;
   gs->_counter_taken_threshold = two_pow_counter_bits / 2;
@@ -24,9 +28,40 @@ void sim_gshare_init(struct SimGshare *gs, uint64_t n, uint64_t m, uint64_t coun
   }
   gs->_pc_bits_mask = sim_gen_mask(0, gs->m);
 
-  // Gives mask that has MSB set to 1 and everything else to 0.
-  // Something like 10000000
-  gs->_global_bhr_mask = sim_math_2pow(gs->n-1);
+  // Outcome of age j (0 being the newest) contributes to bit (n-1-j) mod m of
+  // the folded history. For n <= m this is the plain n bit shift register with
+  // the newest outcome at its MSB.
+  gs->_history_head = 0;
+  gs->_global_bhr_insert_bit = 0;
+  if (gs->n > 0) {
+    gs->_history = calloc(sim_gshare_history_words(gs->n), sizeof(uint64_t));
+    if (gs->_history == NULL) {
+      free(gs->prediction_table);
+      gs->prediction_table = NULL;
+      return -1;
+    }
+    if (gs->m > 0) {
+      gs->_global_bhr_insert_bit = (gs->n - 1) % gs->m;
+    }
+  }
+
+#ifdef SIM_ALIAS_STATS
+  gs->_alias_bhr = 0;
+  if (sim_alias_stats_init(&gs->alias, two_pow_m, gs->_counter_max,
+                           gs->_counter_taken_threshold) != 0) {
+    free(gs->prediction_table);
+    free(gs->_history);
+    gs->prediction_table = NULL;
+    gs->_history = NULL;
+    return -1;
+  }
+#endif
+  return 0;
+}
+
+// One bit per outcome. Computed without n+63 so that it cannot overflow.
+size_t sim_gshare_history_words(uint64_t n) {
+  return n / 64 + 1;
 }
 
 void sim_gshare_free(struct SimGshare *gs) {
@@ -35,7 +70,14 @@ void sim_gshare_free(struct SimGshare *gs) {
   gs->global_bhr = 0;
   gs->_counter_max = 0;
   gs->_counter_taken_threshold = 0;
+  gs->_history_head = 0;
+  gs->_global_bhr_insert_bit = 0;
   free(gs->prediction_table);
+  free(gs->_history);
+  gs->_history = NULL;
+#ifdef SIM_ALIAS_STATS
+  sim_alias_stats_free(&gs->alias);
+#endif
 }
 
 size_t sim_gshare_get_index(struct SimGshare *gs, struct SimInstruction *i) {
@@ -55,11 +97,41 @@ bool sim_gshare_predict(struct SimGshare *gs, size_t index) {
   return false;
 }
 
+// Age a history folded to width bits by one outcome. Ageing every outcome by
+// one moves each folded bit down by one position, i.e. rotates the register
+// right by one. The outcome that falls off the end of the history sits at bit
+// 0 before the rotation and is cancelled by XORing it out of bit width-1
+// afterwards.
+static uint64_t sim_gshare_fold(uint64_t folded, uint64_t width,
+                                uint64_t insert_bit, bool oldest, bool taken) {
+  uint64_t wrapped = (folded & UINT64_C(1)) ^ (uint64_t)oldest;
+  folded = (folded >> 1) | (wrapped << (width - 1));
+  return folded ^ ((uint64_t)taken << insert_bit);
+}
+
+// Shift the outcome into the history in O(1) regardless of n.
 void sim_gshare_update_gbhr(struct SimGshare *gs, bool taken) {
-  gs->global_bhr = gs->global_bhr >> 1;
-  if (taken) {
-    gs->global_bhr |= gs->_global_bhr_mask;
+  if (gs->n == 0) {
+    return;
+  }
+
+  uint64_t *word = &gs->_history[gs->_history_head / 64];
+  uint64_t bit = gs->_history_head % 64;
+  bool oldest = (*word >> bit) & UINT64_C(1);
+  *word = (*word & ~(UINT64_C(1) << bit)) | ((uint64_t)taken << bit);
+  gs->_history_head++;
+  if (gs->_history_head == gs->n) {
+    gs->_history_head = 0;
+  }
+
+  if (gs->m > 0) {
+    gs->global_bhr = sim_gshare_fold(gs->global_bhr, gs->m,
+                                     gs->_global_bhr_insert_bit, oldest, taken);
   }
+#ifdef SIM_ALIAS_STATS
+  gs->_alias_bhr = sim_gshare_fold(gs->_alias_bhr, 64, (gs->n - 1) % 64,
+                                   oldest, taken);
+#endif
 }
 
 void sim_gshare_update_prediction_table(struct SimGshare *gs, size_t index, bool taken) {
@@ -79,6 +151,7 @@ bool sim_gshare_predict_and_update(struct SimGshare *gs, struct SimInstruction *
   size_t index = sim_gshare_get_index(gs, i);
   bool prediction = sim_gshare_predict(gs, index);
   bool outcome = i->taken;
+  sim_gshare_record_access(gs, i, index, prediction);
   sim_gshare_update_gbhr(gs, outcome);
   sim_gshare_update_prediction_table(gs, index, outcome);
   return prediction;
@@ -93,4 +166,7 @@ void sim_gshare_print(struct SimGshare *gs, FILE *f) {
   for (size_t i = 0; i < sim_math_2pow(gs->m); i++) {
     fprintf(f, "%" PRIuPTR " %" PRIu64 "\n", i, gs->prediction_table[i]);
   }
+#ifdef SIM_ALIAS_STATS
+  sim_alias_stats_print(&gs->alias, gs->n > 0 ? "GSHARE" : "BIMODAL", f);
+#endif
 }
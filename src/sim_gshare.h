@@ -3,20 +3,54 @@
 #include <stdint.h>
 #include "sim_parser.h"
 #include <stdio.h>
+#ifdef SIM_ALIAS_STATS
+#include "sim_alias.h"
+#endif
 
+/**
+ * SimGshare is a gshare predictor. With n == 0 it degrades to bimodal.
+ * @var n Global branch history length (bits). May exceed m and 64.
+ * @var m PC bits used to index the prediction table.
+ * @var global_bhr Global branch history folded down to m bits. For n <= m
+ *      this is exactly the n bit global branch history register.
+ * @var prediction_table Table of 2^m saturating counters.
+ * @var _history Circular buffer holding the last n outcomes, one bit each.
+ * @var _history_head Index of the oldest outcome in _history.
+ * @var _global_bhr_insert_bit Bit of global_bhr where newest outcome lands.
+ * @var alias Aliasing instrumentation, only with SIM_ALIAS_STATS.
+ * @var _alias_bhr Global history folded to 64 bits for alias tags, only with
+ *      SIM_ALIAS_STATS. Exact for n <= 64, unlike global_bhr for n > m.
+ */
 struct SimGshare {
   uint64_t n;
   uint64_t m;
   uint64_t global_bhr;
   uint64_t *prediction_table;
 
+  uint64_t *_history;
+  uint64_t _history_head;
+
   uint64_t _pc_bits_mask;
   uint64_t _counter_max;
   uint64_t _counter_taken_threshold;
-  uint64_t _global_bhr_mask;
+  uint64_t _global_bhr_insert_bit;
+
+#ifdef SIM_ALIAS_STATS
+  struct SimAliasStats alias;
+  uint64_t _alias_bhr;
+#endif
 };
 
-void sim_gshare_init(struct SimGshare *gs, uint64_t n, uint64_t m, uint64_t counter_bits);
+/**
+ * Initialize gshare predictor.
+ * @return 0 if initialization is successful.
+ *        -1 if memory allocation fails, e.g. for a huge n or m.
+ */
+int sim_gshare_init(struct SimGshare *gs, uint64_t n, uint64_t m, uint64_t counter_bits);
+/**
+ * Number of uint64_t words backing the history of an n outcome gshare.
+ */
+size_t sim_gshare_history_words(uint64_t n);
 void sim_gshare_free(struct SimGshare *gs);
 size_t sim_gshare_get_index(struct SimGshare *gs, struct SimInstruction *i);
 void sim_gshare_update_prediction_table(struct SimGshare *gs, size_t index, bool taken);
@@ -24,3 +58,14 @@ void sim_gshare_update_gbhr(struct SimGshare *gs, bool taken);
 bool sim_gshare_predict(struct SimGshare *gs, size_t index);
 bool sim_gshare_predict_and_update(struct SimGshare *gs, struct SimInstruction *i);
 void sim_gshare_print(struct SimGshare *gs, FILE *f);
+
+// Record a training access for aliasing instrumentation. Must be used before
+// the global history and the prediction table are updated. Expands to nothing
+// unless SIM_ALIAS_STATS is defined, so normal builds pay no cost.
+#ifdef SIM_ALIAS_STATS
+#define sim_gshare_record_access(gs, i, index, prediction)                     \
+  sim_alias_stats_record(&(gs)->alias, (i)->address, (gs)->_alias_bhr,         \
+                         (index), (prediction), (i)->taken)
+#else
+#define sim_gshare_record_access(gs, i, index, prediction) ((void)0)
+#endif
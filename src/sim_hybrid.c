@@ -6,25 +6,36 @@
 
 #define GSHARE_COUNTER_BITS 3
 
-void sim_hybrid_init(struct SimHybrid *h, uint64_t k, uint64_t n, uint64_t m1, uint64_t m2, uint64_t counter_bits, uint64_t counter_init_val) {
+int sim_hybrid_init(struct SimHybrid *h, uint64_t k, uint64_t n, uint64_t m1, uint64_t m2, uint64_t counter_bits, uint64_t counter_init_val) {
   h->n = n;
   h->k = k;
   h->m1 = m1;
   h->m2 = m2;
   h->global_bhr = 0;
   h->chooser_table = malloc(sizeof(uint64_t) * sim_math_2pow(h->k));
+  if (h->chooser_table == NULL) {
+    return -1;
+  }
 
   uint64_t two_pow_counter_bits = sim_math_2pow(counter_bits);
   h->_pc_bits_mask = sim_gen_mask(0, h->k);
   h->_counter_max = two_pow_counter_bits - 1;
   h->_counter_gshare_threshold = two_pow_counter_bits / 2;
 
-  sim_gshare_init(&h->gshare, h->n, h->m1, GSHARE_COUNTER_BITS);
-  sim_gshare_init(&h->bimodal, 0, h->m2, GSHARE_COUNTER_BITS);
+  if (sim_gshare_init(&h->gshare, h->n, h->m1, GSHARE_COUNTER_BITS) != 0) {
+    free(h->chooser_table);
+    return -1;
+  }
+  if (sim_gshare_init(&h->bimodal, 0, h->m2, GSHARE_COUNTER_BITS) != 0) {
+    sim_gshare_free(&h->gshare);
+    free(h->chooser_table);
+    return -1;
+  }
 
   for (size_t i = 0; i < sim_math_2pow(k); i++) {
     h->chooser_table[i] = counter_init_val;
   }
+  return 0;
 }
 
 void sim_hybrid_free(struct SimHybrid *h) {
@@ -51,6 +62,12 @@ bool sim_hybrid_predict_and_update(struct SimHybrid *h, struct SimInstruction *i
     hybrid_prediction = gshare_prediction;
   }
 
+  if (counter >= h->_counter_gshare_threshold) {
+    sim_gshare_record_access(&h->gshare, i, gshare_index, gshare_prediction);
+  } else {
+    sim_gshare_record_access(&h->bimodal, i, bimodal_index, bimodal_prediction);
+  }
+
   sim_gshare_update_gbhr(&h->gshare, i->taken);
 
   if (counter >= h->_counter_gshare_threshold) {
@@ -21,7 +21,7 @@ struct SimHybrid {
   uint64_t _counter_gshare_threshold;
 };
 
-void sim_hybrid_init(struct SimHybrid *h, uint64_t k, uint64_t n, uint64_t m1, uint64_t m2, uint64_t counter_bits, uint64_t counter_init_val);
+int sim_hybrid_init(struct SimHybrid *h, uint64_t k, uint64_t n, uint64_t m1, uint64_t m2, uint64_t counter_bits, uint64_t counter_init_val);
 void sim_hybrid_free(struct SimHybrid *h);
 bool sim_hybrid_predict_and_update(struct SimHybrid *h, struct SimInstruction *i);
 void sim_hybrid_print(struct SimHybrid *h, FILE *f);
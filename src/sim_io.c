@@ -15,6 +15,17 @@ int sim_read_buf_init(struct SimReadBuf *buf, unsigned int capacity) {
   buf->index = 0;
   buf->size = 0;
   buf->capacity = capacity;
+  buf->remaining = -1;
+  return 0;
+}
+
+int sim_read_buf_seek(struct SimReadBuf *buf, off_t offset, off_t length) {
+  if (lseek(buf->fd, offset, SEEK_SET) < 0) {
+    return -1;
+  }
+  buf->index = 0;
+  buf->size = 0;
+  buf->remaining = length;
   return 0;
 }
 
@@ -29,13 +40,23 @@ void sim_read_buf_free(struct SimReadBuf *buf) {
 // the function to reduce function call overhead.
 inline int sim_read_buf_next_char(struct SimReadBuf *buf, char *c) {
   if (buf->size == 0 || buf->index >= buf->size) {
+    size_t want = buf->capacity;
+    if (buf->remaining >= 0 && (off_t)want > buf->remaining) {
+      want = buf->remaining;
+    }
+    if (want == 0) {
+      return 0;
+    }
     errno = 0;
-    ssize_t len = read(buf->fd, buf->buf, buf->capacity);
+    ssize_t len = read(buf->fd, buf->buf, want);
     if (len == 0) {
       return 0;
     } else if (len < 1) {
       return -1;
     }
+    if (buf->remaining >= 0) {
+      buf->remaining -= len;
+    }
     buf->index = 0;
     buf->size = len;
   }
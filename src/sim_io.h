@@ -9,6 +9,7 @@
  * @var capacity Capacity of the buffer
  * @var size Current size of the buffer
  * @var index Seek index. Anything between index-size is buffered.
+ * @var remaining Bytes left to read from fd, or -1 to read until EOF.
  */
 struct SimReadBuf {
   int fd;
@@ -16,6 +17,7 @@ struct SimReadBuf {
   unsigned int capacity;
   unsigned int size;
   unsigned int index;
+  off_t remaining;
 };
 
 /**
@@ -33,6 +35,16 @@ int sim_read_buf_init(struct SimReadBuf *buf, unsigned int capacity);
  */
 void sim_read_buf_free(struct SimReadBuf *buf);
 
+/**
+ * Discard buffered data and continue reading at offset of the file.
+ * @param[in] buf Initialized SimReadBuf.
+ * @param[in] offset Byte offset in the file to read from.
+ * @param[in] length Bytes to read before reporting EOF, or -1 for no limit.
+ * @return 0 if the seek is successful.
+ *        -1 if the underlying lseek fails.
+ */
+int sim_read_buf_seek(struct SimReadBuf *buf, off_t offset, off_t length);
+
 /**
  * Get next character from the read buffer.
  * @param[in]  buf Initialized SimReadBuf.
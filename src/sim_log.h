@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdio.h>
+
+// log is a macro that writes to the f if f is not NULL
+#define log(file, f, ...)                                                      \
+  if (file != NULL)                                                            \
+    fprintf(file, f, ##__VA_ARGS__);
+
+#define fatal(file, f, ...) log(file, "Fatal: " f "\n", ##__VA_ARGS__);
+#define usage(file, f, ...) log(file, "Usage: " f "\n", ##__VA_ARGS__);
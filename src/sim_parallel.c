@@ -0,0 +1,369 @@
+#include "sim_parallel.h"
+#include "sim_math.h"
+#include "sim_thread_pool.h"
+#include "sim_trace.h"
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Partitions per thread. More partitions than threads lets the work-stealing
+// pool even out partitions holding hot table entries.
+#define SIM_PARALLEL_PARTITIONS_PER_THREAD 4
+
+struct SimParallelBranch {
+  size_t index;
+  bool taken;
+};
+
+struct SimParallelRun {
+  struct SimGshare *gs;
+  const char *path;
+  size_t chunks;
+  size_t partitions;
+  size_t entries_per_partition;
+  // Chunk c decodes the bytes between offsets[c] and offsets[c + 1] of the
+  // file into traces[c]. Its branches are begins[c] to begins[c + 1] of the
+  // whole trace.
+  off_t *offsets;
+  struct SimTrace *traces;
+  int *trace_status;
+  size_t *begins;
+  // index_status[c] is 0 once chunk c has been indexed.
+  int *index_status;
+  // Branches in trace order and stably grouped by partition.
+  struct SimParallelBranch *branches;
+  struct SimParallelBranch *partitioned;
+  // counts[c * partitions + p] is the number of branches of chunk c falling in
+  // partition p. Turned into scatter offsets before the partition phase.
+  size_t *counts;
+  // starts[p] is the first branch of partition p in partitioned.
+  size_t *starts;
+  uint64_t *mispredictions;
+};
+
+struct SimParallelTask {
+  struct SimParallelRun *run;
+  size_t id;
+};
+
+// Split the file into byte ranges of about equal size that end right after a
+// newline, so that every chunk decodes whole lines.
+static int sim_parallel_split(struct SimParallelRun *r, int fd, off_t size) {
+  char buf[4096];
+  r->offsets[0] = 0;
+  for (size_t c = 1; c < r->chunks; c++) {
+    off_t pos = size / r->chunks * c;
+    if (pos <= r->offsets[c - 1]) {
+      r->offsets[c] = r->offsets[c - 1];
+      continue;
+    }
+    // The chunk starts after the first newline at or after pos - 1.
+    pos--;
+    r->offsets[c] = size;
+    ssize_t len;
+    while ((len = pread(fd, buf, sizeof(buf), pos)) > 0) {
+      char *nl = memchr(buf, '\n', len);
+      if (nl != NULL) {
+        r->offsets[c] = pos + (nl - buf) + 1;
+        break;
+      }
+      pos += len;
+    }
+    if (len < 0) {
+      return -1;
+    }
+  }
+  r->offsets[r->chunks] = size;
+  return 0;
+}
+
+static void sim_parallel_load_chunk(void *arg) {
+  struct SimParallelTask *task = arg;
+  struct SimParallelRun *r = task->run;
+  off_t offset = r->offsets[task->id];
+  r->trace_status[task->id] = sim_trace_load_range(
+      &r->traces[task->id], r->path, offset, r->offsets[task->id + 1] - offset);
+}
+
+// Replay outcomes from to to of the whole trace onto the history of h.
+static void sim_parallel_replay(struct SimParallelRun *r, struct SimGshare *h,
+                                size_t from, size_t to) {
+  size_t c = 0;
+  for (size_t k = from; k < to; k++) {
+    while (k >= r->begins[c + 1]) {
+      c++;
+    }
+    struct SimInstruction *inst = &r->traces[c].instructions[k - r->begins[c]];
+    sim_gshare_update_gbhr(h, inst->taken);
+  }
+}
+
+// Compute the table index of every branch of the chunk and count branches per
+// partition.
+static void sim_parallel_index_chunk(void *arg) {
+  struct SimParallelTask *task = arg;
+  struct SimParallelRun *r = task->run;
+  size_t begin = r->begins[task->id];
+  size_t end = r->begins[task->id + 1];
+  struct SimInstruction *instructions = r->traces[task->id].instructions;
+  size_t *counts = &r->counts[task->id * r->partitions];
+
+  // Global history only depends on the last n outcomes, so replaying them
+  // onto an empty history gives the history at the start of the chunk. They
+  // may come from several earlier chunks.
+  struct SimGshare h = *r->gs;
+  h.prediction_table = NULL;
+  h.global_bhr = 0;
+  h._history_head = 0;
+  h._history = NULL;
+  if (h.n > 0) {
+    h._history = calloc(sim_gshare_history_words(h.n), sizeof(uint64_t));
+    if (h._history == NULL) {
+      return;
+    }
+  }
+  sim_parallel_replay(r, &h, begin > h.n ? begin - h.n : 0, begin);
+
+  for (size_t k = begin; k < end; k++) {
+    struct SimInstruction *inst = &instructions[k - begin];
+    size_t index = sim_gshare_get_index(&h, inst);
+    r->branches[k].index = index;
+    r->branches[k].taken = inst->taken;
+    counts[index / r->entries_per_partition]++;
+    sim_gshare_update_gbhr(&h, inst->taken);
+  }
+  free(h._history);
+  r->index_status[task->id] = 0;
+}
+
+// Scatter the chunk's branches to their partitions, keeping trace order.
+static void sim_parallel_partition_chunk(void *arg) {
+  struct SimParallelTask *task = arg;
+  struct SimParallelRun *r = task->run;
+  size_t *offsets = &r->counts[task->id * r->partitions];
+
+  for (size_t k = r->begins[task->id]; k < r->begins[task->id + 1]; k++) {
+    size_t p = r->branches[k].index / r->entries_per_partition;
+    r->partitioned[offsets[p]++] = r->branches[k];
+  }
+}
+
+// Simulate the counters of one partition. No other partition touches them.
+static void sim_parallel_simulate_partition(void *arg) {
+  struct SimParallelTask *task = arg;
+  struct SimParallelRun *r = task->run;
+  uint64_t mispredictions = 0;
+  for (size_t k = r->starts[task->id]; k < r->starts[task->id + 1]; k++) {
+    struct SimParallelBranch *b = &r->partitioned[k];
+    if (sim_gshare_predict(r->gs, b->index) != b->taken) {
+      mispredictions++;
+    }
+    sim_gshare_update_prediction_table(r->gs, b->index, b->taken);
+  }
+  r->mispredictions[task->id] = mispredictions;
+}
+
+static int sim_parallel_run_tasks(struct SimParallelRun *r,
+                                  struct SimParallelTask *tasks,
+                                  struct SimJob *jobs, size_t count,
+                                  void (*run)(void *), size_t threads,
+                                  bool by_partition_size) {
+  for (size_t i = 0; i < count; i++) {
+    tasks[i] = (struct SimParallelTask){.run = r, .id = i};
+    jobs[i] = (struct SimJob){.run = run, .arg = &tasks[i], .cost = 1};
+    if (by_partition_size) {
+      jobs[i].cost = r->starts[i + 1] - r->starts[i];
+    }
+  }
+  return sim_thread_pool_run(jobs, count, threads);
+}
+
+// Run the decode, index, partition and simulation phases. Each phase waits for
+// the previous one to finish on all threads.
+static int sim_parallel_run_phases(struct SimParallelRun *r,
+                                   struct SimParallelTask *tasks,
+                                   struct SimJob *jobs, size_t threads) {
+  if (sim_parallel_run_tasks(r, tasks, jobs, r->chunks,
+                             sim_parallel_load_chunk, threads, false) != 0) {
+    return -1;
+  }
+  r->begins[0] = 0;
+  for (size_t c = 0; c < r->chunks; c++) {
+    if (r->trace_status[c] != 0) {
+      return -1;
+    }
+    r->begins[c + 1] = r->begins[c] + r->traces[c].size;
+  }
+
+  size_t size = r->begins[r->chunks];
+  r->branches = malloc(size * sizeof(struct SimParallelBranch));
+  r->partitioned = malloc(size * sizeof(struct SimParallelBranch));
+  if (size > 0 && (r->branches == NULL || r->partitioned == NULL)) {
+    return -1;
+  }
+
+  if (sim_parallel_run_tasks(r, tasks, jobs, r->chunks,
+                             sim_parallel_index_chunk, threads, false) != 0) {
+    return -1;
+  }
+  for (size_t c = 0; c < r->chunks; c++) {
+    if (r->index_status[c] != 0) {
+      return -1;
+    }
+  }
+  // Decoded chunks are no longer needed once branches holds the indices.
+  for (size_t c = 0; c < r->chunks; c++) {
+    sim_trace_free(&r->traces[c]);
+    r->trace_status[c] = -1;
+  }
+
+  // Exclusive prefix sum over partitions, then chunks, turns counts into the
+  // position of each chunk's first branch within each partition.
+  size_t offset = 0;
+  for (size_t p = 0; p < r->partitions; p++) {
+    r->starts[p] = offset;
+    for (size_t c = 0; c < r->chunks; c++) {
+      size_t count = r->counts[c * r->partitions + p];
+      r->counts[c * r->partitions + p] = offset;
+      offset += count;
+    }
+  }
+  r->starts[r->partitions] = offset;
+
+  if (sim_parallel_run_tasks(r, tasks, jobs, r->chunks,
+                             sim_parallel_partition_chunk, threads,
+                             false) != 0) {
+    return -1;
+  }
+  return sim_parallel_run_tasks(r, tasks, jobs, r->partitions,
+                                sim_parallel_simulate_partition, threads, true);
+}
+
+// Stream the trace through the predictor on the calling thread.
+static int sim_parallel_run_sequential(struct SimGshare *gs, int fd,
+                                       uint64_t *predictions,
+                                       uint64_t *mispredictions) {
+  struct SimReadBuf buffer = {.buf = NULL, .fd = fd};
+  struct SimParser parser = {.buf = buffer};
+  if (sim_read_buf_init(&parser.buf, 1 << 16) < 0) {
+    return -1;
+  }
+  int status;
+  struct SimInstruction inst;
+  while ((status = sim_parser_next_token(&parser, &inst)) > 0) {
+    (*predictions)++;
+    if (sim_gshare_predict_and_update(gs, &inst) != inst.taken) {
+      (*mispredictions)++;
+    }
+  }
+  sim_read_buf_free(&parser.buf);
+  return status;
+}
+
+int sim_parallel_gshare_run(struct SimGshare *gs, const char *path,
+                            size_t threads, uint64_t *predictions,
+                            uint64_t *mispredictions) {
+  *predictions = 0;
+  *mispredictions = 0;
+  int fd = open(path, O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  if (threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? (size_t)cpus : 1;
+  }
+
+  // A single thread gains nothing from the phases. Alias instrumentation
+  // keeps one tag table for all entries, so the instrumented build also
+  // simulates sequentially.
+  bool sequential = threads == 1;
+#ifdef SIM_ALIAS_STATS
+  sequential = true;
+#endif
+  if (sequential) {
+    int status = sim_parallel_run_sequential(gs, fd, predictions,
+                                             mispredictions);
+    close(fd);
+    return status;
+  }
+
+  uint64_t entries = sim_math_2pow(gs->m);
+  struct SimParallelRun r = {.gs = gs, .path = path};
+  r.chunks = threads;
+  r.partitions = threads * SIM_PARALLEL_PARTITIONS_PER_THREAD;
+  if (r.partitions > entries) {
+    r.partitions = entries;
+  }
+  r.entries_per_partition = (entries + r.partitions - 1) / r.partitions;
+  size_t tasks_size = r.chunks > r.partitions ? r.chunks : r.partitions;
+
+  r.offsets = malloc((r.chunks + 1) * sizeof(off_t));
+  r.traces = calloc(r.chunks, sizeof(struct SimTrace));
+  r.trace_status = malloc(r.chunks * sizeof(int));
+  r.begins = malloc((r.chunks + 1) * sizeof(size_t));
+  r.index_status = malloc(r.chunks * sizeof(int));
+  r.counts = calloc(r.chunks * r.partitions, sizeof(size_t));
+  r.starts = calloc(r.partitions + 1, sizeof(size_t));
+  r.mispredictions = calloc(r.partitions, sizeof(uint64_t));
+  struct SimParallelTask *tasks =
+      malloc(tasks_size * sizeof(struct SimParallelTask));
+  struct SimJob *jobs = malloc(tasks_size * sizeof(struct SimJob));
+  for (size_t c = 0; c < r.chunks; c++) {
+    if (r.trace_status != NULL) {
+      r.trace_status[c] = -1;
+    }
+    if (r.index_status != NULL) {
+      r.index_status[c] = -1;
+    }
+  }
+
+  int status = -1;
+  if (r.offsets != NULL && r.traces != NULL && r.trace_status != NULL &&
+      r.begins != NULL && r.index_status != NULL && r.counts != NULL &&
+      r.starts != NULL && r.mispredictions != NULL && tasks != NULL &&
+      jobs != NULL && sim_parallel_split(&r, fd, st.st_size) == 0) {
+    status = sim_parallel_run_phases(&r, tasks, jobs, threads);
+  }
+  close(fd);
+
+  if (status == 0) {
+    *predictions = r.begins[r.chunks];
+    for (size_t p = 0; p < r.partitions; p++) {
+      *mispredictions += r.mispredictions[p];
+    }
+    // Leave the global history where the sequential simulation would.
+    size_t replay = *predictions > gs->n ? *predictions - gs->n : 0;
+    for (size_t k = replay; k < *predictions; k++) {
+      sim_gshare_update_gbhr(gs, r.branches[k].taken);
+    }
+  }
+
+  if (r.trace_status != NULL) {
+    for (size_t c = 0; c < r.chunks; c++) {
+      if (r.trace_status[c] == 0) {
+        sim_trace_free(&r.traces[c]);
+      }
+    }
+  }
+  free(r.offsets);
+  free(r.traces);
+  free(r.trace_status);
+  free(r.begins);
+  free(r.index_status);
+  free(r.branches);
+  free(r.partitioned);
+  free(r.counts);
+  free(r.starts);
+  free(r.mispredictions);
+  free(tasks);
+  free(jobs);
+  return status;
+}
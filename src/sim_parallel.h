@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "sim_gshare.h"
+
+/**
+ * Simulate a bimodal or gshare predictor over the whole trace file on several
+ * threads, with results bit-identical to sim_gshare_predict_and_update.
+ *
+ * Global history is built from actual outcomes, so every branch's table index
+ * is known from the trace alone and each counter evolves independently of the
+ * others. The file is split at line boundaries into byte ranges that are
+ * decoded in parallel. Each chunk then computes its index stream, rebuilding
+ * its starting history from the n outcomes before it. Branches are stably
+ * partitioned by table index range and every partition's counters are
+ * simulated in trace order on its own thread. With one thread, or in the
+ * SIM_ALIAS_STATS build, the trace is simply streamed through the predictor.
+ * @param[in,out] gs Freshly initialized predictor. Left in the state the
+ *                sequential simulation would leave it in.
+ * @param[in]     path Path of the trace file.
+ * @param[in]     threads Number of threads. 0 uses the number of online CPUs.
+ * @param[out]    predictions Number of branches in the trace.
+ * @param[out]    mispredictions Number of mispredictions.
+ * @return 0 if the simulation is successful.
+ *        -1 if the trace cannot be read or memory allocation fails.
+ */
+int sim_parallel_gshare_run(struct SimGshare *gs, const char *path,
+                            size_t threads, uint64_t *predictions,
+                            uint64_t *mispredictions);
@@ -0,0 +1,322 @@
+#include "sim_sample.h"
+#include "sim_io.h"
+#include "sim_parser.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// Samples measured before the confidence interval is trusted for early stop.
+#define SIM_SAMPLE_MIN_SAMPLES 30
+#define SIM_SAMPLE_INDEX_CHUNK (1 << 20)
+
+// SimSampleIndex records where intervals and their warm-ups start in the file.
+// Warm-ups start at lines congruent to -warmup modulo interval, one per
+// interval of lines. Entry k of warmup_offsets is the start of the one in
+// [k*interval, (k+1)*interval), so interval j warms up from entry
+// (j*interval - warmup) / interval and both arrays grow with the trace only.
+struct SimSampleIndex {
+  uint64_t lines;
+  off_t *interval_offsets;
+  off_t *warmup_offsets;
+  size_t capacity;
+};
+
+void sim_sample_config_init(struct SimSampleConfig *config) {
+  config->interval = 10000;
+  config->warmup = 10000;
+  config->period = 10;
+  config->samples = 0;
+  config->confidence = 0.95;
+  config->target = 0;
+  config->seed = 1;
+}
+
+// splitmix64 keeps runs reproducible for a given seed.
+static uint64_t sim_sample_rand(uint64_t *state) {
+  uint64_t z = (*state += UINT64_C(0x9e3779b97f4a7c15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return z ^ (z >> 31);
+}
+
+// Two sided standard normal quantile for the confidence level.
+static double sim_sample_z(double confidence) {
+  double lo = 0;
+  double hi = 10;
+  for (int i = 0; i < 100; i++) {
+    double mid = (lo + hi) / 2;
+    if (erf(mid / sqrt(2)) < confidence) {
+      lo = mid;
+    } else {
+      hi = mid;
+    }
+  }
+  return (lo + hi) / 2;
+}
+
+static int sim_sample_index_set(off_t **offsets, size_t *capacity, size_t j,
+                                off_t offset, off_t **other) {
+  if (j >= *capacity) {
+    size_t new_capacity = *capacity == 0 ? 1024 : *capacity * 2;
+    while (new_capacity <= j) {
+      new_capacity *= 2;
+    }
+    off_t *a = realloc(*offsets, new_capacity * sizeof(off_t));
+    if (a == NULL) {
+      return -1;
+    }
+    *offsets = a;
+    off_t *b = realloc(*other, new_capacity * sizeof(off_t));
+    if (b == NULL) {
+      return -1;
+    }
+    *other = b;
+    *capacity = new_capacity;
+  }
+  (*offsets)[j] = offset;
+  return 0;
+}
+
+// Count lines and record interval and warm-up start offsets. Only newlines are
+// looked for, which is much cheaper than decoding the branches.
+static int sim_sample_index_build(struct SimSampleIndex *index, int fd,
+                                  uint64_t interval, uint64_t warmup) {
+  index->lines = 0;
+  index->interval_offsets = NULL;
+  index->warmup_offsets = NULL;
+  index->capacity = 0;
+
+  char *chunk = malloc(SIM_SAMPLE_INDEX_CHUNK);
+  if (chunk == NULL) {
+    return -1;
+  }
+
+  uint64_t warmup_shift = warmup % interval;
+  off_t chunk_offset = 0;
+  off_t line_offset = 0;
+  ssize_t len;
+  int status = 0;
+  while (status == 0 && (len = read(fd, chunk, SIM_SAMPLE_INDEX_CHUNK)) > 0) {
+    char *p = chunk;
+    char *end = chunk + len;
+    while ((p = memchr(p, '\n', end - p)) != NULL) {
+      // line_offset is the start of line index->lines, which is now complete.
+      uint64_t l = index->lines;
+      if (l % interval == 0) {
+        status |= sim_sample_index_set(&index->interval_offsets,
+                                       &index->capacity, l / interval,
+                                       line_offset, &index->warmup_offsets);
+      }
+      if ((l + warmup_shift) % interval == 0) {
+        status |= sim_sample_index_set(&index->warmup_offsets,
+                                       &index->capacity, l / interval,
+                                       line_offset, &index->interval_offsets);
+      }
+      index->lines++;
+      p++;
+      line_offset = chunk_offset + (p - chunk);
+    }
+    chunk_offset += len;
+  }
+  free(chunk);
+  if (len < 0) {
+    status = -1;
+  }
+  return status;
+}
+
+static void sim_sample_index_free(struct SimSampleIndex *index) {
+  free(index->interval_offsets);
+  free(index->warmup_offsets);
+  index->interval_offsets = NULL;
+  index->warmup_offsets = NULL;
+  index->capacity = 0;
+}
+
+static int sim_sample_compare_interval(const void *a, const void *b) {
+  uint64_t ia = *(const uint64_t *)a;
+  uint64_t ib = *(const uint64_t *)b;
+  return ia < ib ? -1 : ia > ib;
+}
+
+// Choose the intervals to measure in measurement order. Intervals are measured
+// in trace order, so stale predictor state left between samples comes from the
+// nearest earlier sample. With an early stop target they are measured in
+// random order instead, so that any prefix is a random sample.
+static uint64_t *sim_sample_select(struct SimSampleConfig *config,
+                                   uint64_t intervals, uint64_t *selected) {
+  uint64_t state = config->seed;
+  uint64_t *order = malloc(intervals * sizeof(uint64_t));
+  if (order == NULL) {
+    return NULL;
+  }
+
+  uint64_t count = 0;
+  if (config->samples > 0) {
+    for (uint64_t i = 0; i < intervals; i++) {
+      order[i] = i;
+    }
+    count = config->samples < intervals ? config->samples : intervals;
+    // Partial Fisher-Yates: the first count entries are a random sample.
+    for (uint64_t i = 0; i < count; i++) {
+      uint64_t j = i + sim_sample_rand(&state) % (intervals - i);
+      uint64_t t = order[i];
+      order[i] = order[j];
+      order[j] = t;
+    }
+  } else {
+    uint64_t period = config->period > 0 ? config->period : 1;
+    uint64_t start = sim_sample_rand(&state) % period;
+    if (start >= intervals) {
+      start = 0;
+    }
+    for (uint64_t i = start; i < intervals; i += period) {
+      order[count++] = i;
+    }
+  }
+
+  if (config->target > 0) {
+    for (uint64_t i = count; i > 1; i--) {
+      uint64_t j = sim_sample_rand(&state) % i;
+      uint64_t t = order[i - 1];
+      order[i - 1] = order[j];
+      order[j] = t;
+    }
+  } else {
+    qsort(order, count, sizeof(uint64_t), sim_sample_compare_interval);
+  }
+
+  *selected = count;
+  return order;
+}
+
+// Decode count branches starting at offset. Mispredictions are only counted
+// when mispredictions is not NULL.
+static int sim_sample_simulate(struct SimSimulator *s, struct SimParser *parser,
+                               off_t offset, uint64_t count,
+                               uint64_t *mispredictions) {
+  if (sim_read_buf_seek(&parser->buf, offset, -1) != 0) {
+    return -1;
+  }
+
+  struct SimInstruction inst;
+  for (uint64_t i = 0; i < count; i++) {
+    if (sim_parser_next_token(parser, &inst) <= 0) {
+      return -1;
+    }
+    bool prediction = sim_simulator_predict_and_update(s, &inst);
+    if (mispredictions != NULL && prediction != inst.taken) {
+      (*mispredictions)++;
+    }
+  }
+  return 0;
+}
+
+int sim_sample_run(struct SimSampleConfig *config, struct SimArgs *args,
+                   struct SimSampleResult *result) {
+  memset(result, 0, sizeof(*result));
+  if (config->interval == 0) {
+    return -1;
+  }
+
+  int fd = open(args->tracefile, O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+
+  struct SimSampleIndex index;
+  if (sim_sample_index_build(&index, fd, config->interval, config->warmup) !=
+      0) {
+    sim_sample_index_free(&index);
+    close(fd);
+    return -1;
+  }
+  result->total_predictions = index.lines;
+  result->intervals = index.lines / config->interval;
+
+  uint64_t *order = NULL;
+  if (result->intervals > 0) {
+    order = sim_sample_select(config, result->intervals, &result->selected);
+  }
+  struct SimSimulator s;
+  struct SimReadBuf buffer = {.buf = NULL, .fd = fd};
+  struct SimParser parser = {.buf = buffer};
+  if (order == NULL || sim_simulator_init(&s, args) != 0) {
+    free(order);
+    sim_sample_index_free(&index);
+    close(fd);
+    return -1;
+  }
+  if (sim_read_buf_init(&parser.buf, 1 << 16) < 0) {
+    sim_simulator_free(&s);
+    free(order);
+    sim_sample_index_free(&index);
+    close(fd);
+    return -1;
+  }
+
+  double z = sim_sample_z(config->confidence);
+  double population = result->intervals;
+  // Welford's running mean and sum of squared deviations of interval rates.
+  double mean = 0;
+  double m2 = 0;
+  // Line right after the last measured interval. The predictor there holds the
+  // state left by the previous warm-up and interval, which trained on more
+  // lines than a fresh warm-up reaching that line would, so a warm-up starting
+  // before it resumes from there instead.
+  uint64_t last_end = 0;
+  int status = 0;
+  for (uint64_t k = 0; k < result->selected; k++) {
+    uint64_t i = order[k];
+    uint64_t first = i * config->interval;
+    off_t warmup_offset = 0;
+    uint64_t warmup = first;
+    if (first >= config->warmup) {
+      warmup_offset =
+          index.warmup_offsets[(first - config->warmup) / config->interval];
+      warmup = config->warmup;
+    }
+    if (last_end > 0 && last_end <= first && first - last_end < warmup) {
+      warmup_offset = index.interval_offsets[last_end / config->interval];
+      warmup = first - last_end;
+    }
+    last_end = first + config->interval;
+
+    uint64_t mispredictions = 0;
+    if (sim_sample_simulate(&s, &parser, warmup_offset, warmup, NULL) != 0 ||
+        sim_sample_simulate(&s, &parser, index.interval_offsets[i],
+                            config->interval, &mispredictions) != 0) {
+      status = -1;
+      break;
+    }
+
+    result->measured++;
+    result->predictions += config->interval;
+    result->mispredictions += mispredictions;
+    double rate = (double)mispredictions / config->interval;
+    double delta = rate - mean;
+    mean += delta / result->measured;
+    m2 += delta * (rate - mean);
+
+    double n = result->measured;
+    result->rate = mean * 100.0;
+    result->half_width = INFINITY;
+    if (result->measured > 1) {
+      double fpc = 1.0 - n / population;
+      result->half_width = z * sqrt(m2 / (n - 1) / n * fpc) * 100.0;
+    }
+    if (config->target > 0 && result->measured >= SIM_SAMPLE_MIN_SAMPLES &&
+        result->half_width <= config->target) {
+      break;
+    }
+  }
+
+  sim_read_buf_free(&parser.buf);
+  sim_simulator_free(&s);
+  free(order);
+  sim_sample_index_free(&index);
+  close(fd);
+  return status;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "sim_simulator.h"
+
+/**
+ * SimSampleConfig configures a sampled simulation. The trace is split into
+ * intervals of interval branches and only the selected ones are measured.
+ * @var interval Branches per interval.
+ * @var warmup Branches right before each sampled interval that only update
+ *      predictor state.
+ * @var period Systematic sampling: measure every period-th interval. Used when
+ *      samples is 0.
+ * @var samples Random sampling: number of intervals to measure.
+ * @var confidence Confidence level of the reported interval, e.g. 0.95.
+ * @var target Stop once the confidence interval half width, in percentage
+ *      points, is at or below target. 0 measures every selected interval.
+ * @var seed Seed for choosing and ordering the intervals.
+ */
+struct SimSampleConfig {
+  uint64_t interval;
+  uint64_t warmup;
+  uint64_t period;
+  uint64_t samples;
+  double confidence;
+  double target;
+  uint64_t seed;
+};
+
+/**
+ * SimSampleResult is the outcome of a sampled simulation.
+ * @var total_predictions Branches in the whole trace.
+ * @var intervals Complete intervals in the trace.
+ * @var selected Intervals selected for measurement.
+ * @var measured Intervals actually measured. Less than selected on early stop.
+ * @var predictions Branches measured.
+ * @var mispredictions Mispredictions among the measured branches.
+ * @var rate Estimated misprediction rate in percent.
+ * @var half_width Confidence interval half width in percentage points.
+ */
+struct SimSampleResult {
+  uint64_t total_predictions;
+  uint64_t intervals;
+  uint64_t selected;
+  uint64_t measured;
+  uint64_t predictions;
+  uint64_t mispredictions;
+  double rate;
+  double half_width;
+};
+
+/**
+ * Fill config with the defaults: 10000 branch intervals and warm-up,
+ * systematic sampling of every 10th interval, 95% confidence, no early stop.
+ */
+void sim_sample_config_init(struct SimSampleConfig *config);
+
+/**
+ * Run a sampled simulation of args->tracefile with the predictor in args.
+ *
+ * Branches outside of warm-up and measured intervals are skipped without being
+ * decoded. Predictor state carries over between samples and every sample is
+ * preceded by its functional warm-up. Intervals are measured in trace order,
+ * or in random order when an early stop target is set so that stopping early
+ * still leaves an unbiased sample. The confidence interval treats interval
+ * misprediction rates as a sample of all intervals, with the finite population
+ * correction applied. It only bounds the sampling error: a warm-up too short
+ * for the predictor's table adds a bias it does not cover.
+ * @param[in]  config Sampling configuration.
+ * @param[in]  args Predictor and trace file.
+ * @param[out] result Estimate.
+ * @return 0 if the simulation is successful.
+ *        -1 if the trace cannot be read, has no complete interval, or memory
+ *           allocation fails.
+ */
+int sim_sample_run(struct SimSampleConfig *config, struct SimArgs *args,
+                   struct SimSampleResult *result);
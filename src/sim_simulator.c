@@ -0,0 +1,182 @@
+#include "sim_simulator.h"
+
+#include <inttypes.h>
+#include <string.h>
+#include "sim_log.h"
+#include "sim_math.h"
+
+static void help(FILE *f) {
+  log(f, "Usage: sim SIMULATION_TYPE [SIMULATION_ARGS]\n");
+  log(f, "       sim batch MANIFEST_FILE [csv|json]\n");
+  log(f, "       sim sample [SAMPLE_OPTIONS] SIMULATION_TYPE "
+         "[SIMULATION_ARGS]\n");
+  log(f, "       sim parallel [-t THREADS] gshare|bimodal "
+         "[SIMULATION_ARGS]\n");
+  log(f, "       SIMULATION_TYPE should be one of smith, bimodal, gshare, "
+         "hybrid\n");
+}
+
+int sim_simulator_parse_args(int argc, char *argv[], FILE *f,
+                             struct SimArgs *args) {
+  args->type = 0;
+
+  // Requires at least one argument to identify simulator type.
+  if (argc < 2) {
+    fatal(f, "Expect one of the simulator types as the first argument");
+    help(f);
+    return -1;
+  }
+
+  if (strcmp("smith", argv[1]) == 0) {
+    // sim smith COUNTER_BITS TRACE_FILE
+    if (argc != 4) {
+      fatal(f, "Missing required arguments for the smith branch predictor");
+      usage(f, "smith COUNTER_BITS TRACE_FILE");
+      return -1;
+    }
+    int64_t counter_bits;
+    if (sim_math_strtoint64(argv[2], &counter_bits) != 0) {
+      fatal(f, "Error parsing \"%s\" as number", argv[2]);
+      return -1;
+    }
+    args->type = SMITH_N_BIT;
+    args->counter_bits = counter_bits;
+    args->tracefile = argv[3];
+  } else if (strcmp("gshare", argv[1]) == 0) {
+    // sim gshare <M1> <N> <tracefile>
+    if (argc != 5) {
+      fatal(f, "Missing required arguments for the gshare branch predictor");
+      usage(f, "gshare PC_BITS GLOBAL_BRANCH_HISTORY_REGISTER_BITS TRACE_FILE");
+      return -1;
+    }
+    int64_t pc_bits;
+    if (sim_math_strtoint64(argv[2], &pc_bits) != 0) {
+      fatal(f, "Error parsing \"%s\" as number", argv[2]);
+      return -1;
+    }
+    int64_t global_branch_history_register_bits;
+    if (sim_math_strtoint64(argv[3], &global_branch_history_register_bits) !=
+        0) {
+      fatal(f, "Error parsing \"%s\" as number", argv[3]);
+      return -1;
+    }
+
+    // TOOD: Handle negative case?
+    args->type = GSHARE;
+    args->pc_bits_1 = pc_bits;
+    args->gbhr_bits = global_branch_history_register_bits;
+    args->tracefile = argv[4];
+  } else if (strcmp("bimodal", argv[1]) == 0) {
+    // sim bimodal <M2> <tracefile>
+    if (argc != 4) {
+      return -1;
+    }
+    int64_t pc_bits;
+    if (sim_math_strtoint64(argv[2], &pc_bits) != 0) {
+      fatal(f, "Error parsing \"%s\" as number", argv[2]);
+      return -1;
+    }
+    args->type = BIMODAL;
+    args->pc_bits_1 = pc_bits;
+    args->tracefile = argv[3];
+  } else if (strcmp("hybrid", argv[1]) == 0) {
+    // sim hybrid <K> <M1> <N> <M2> <tracefile>
+    if (argc != 7) {
+      return -1;
+    }
+    int64_t chooser_bits;
+    if (sim_math_strtoint64(argv[2], &chooser_bits) != 0) {
+      fatal(f, "Error parsing \"%s\" as number", argv[2]);
+      return -1;
+    }
+    int64_t pc_bits_1;
+    if (sim_math_strtoint64(argv[3], &pc_bits_1) != 0) {
+      fatal(f, "Error parsing \"%s\" as number", argv[3]);
+      return -1;
+    }
+    int64_t global_branch_history_register_bits;
+    if (sim_math_strtoint64(argv[4], &global_branch_history_register_bits) !=
+        0) {
+      fatal(f, "Error parsing \"%s\" as number", argv[4]);
+      return -1;
+    }
+    int64_t pc_bits_2;
+    if (sim_math_strtoint64(argv[5], &pc_bits_2) != 0) {
+      fatal(f, "Error parsing \"%s\" as number", argv[5]);
+      return -1;
+    }
+    args->type = HYBRID;
+    args->chooser_bits = chooser_bits;
+    args->pc_bits_1 = pc_bits_1;
+    args->gbhr_bits = global_branch_history_register_bits;
+    args->pc_bits_2 = pc_bits_2;
+    args->tracefile = argv[6];
+  } else {
+    log(f, "%s is not a valid simulation type\n", argv[1]);
+  }
+
+  return 0;
+}
+
+void sim_simulator_format_args(struct SimArgs *args, char *str, size_t size) {
+  if (args->type == SMITH_N_BIT) {
+    snprintf(str, size, "smith %" PRIu64, args->counter_bits);
+  } else if (args->type == GSHARE) {
+    snprintf(str, size, "gshare %" PRIu64 " %" PRIu64, args->pc_bits_1,
+             args->gbhr_bits);
+  } else if (args->type == BIMODAL) {
+    snprintf(str, size, "bimodal %" PRIu64, args->pc_bits_1);
+  } else if (args->type == HYBRID) {
+    snprintf(str, size, "hybrid %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64,
+             args->chooser_bits, args->pc_bits_1, args->gbhr_bits,
+             args->pc_bits_2);
+  } else {
+    snprintf(str, size, "invalid");
+  }
+}
+
+int sim_simulator_init(struct SimSimulator *s, struct SimArgs *args) {
+  s->type = args->type;
+  if (args->type == SMITH_N_BIT) {
+    sim_smith_n_bit_init(&s->smith_n_bit, args->counter_bits);
+  } else if (args->type == GSHARE) {
+    return sim_gshare_init(&s->gshare, args->gbhr_bits, args->pc_bits_1, 3);
+  } else if (args->type == BIMODAL) {
+    return sim_gshare_init(&s->gshare, 0, args->pc_bits_1, 3);
+  } else if (args->type == HYBRID) {
+    return sim_hybrid_init(&s->hybrid, args->chooser_bits, args->gbhr_bits,
+                           args->pc_bits_1, args->pc_bits_2, 2, 1);
+  } else {
+    return -1;
+  }
+  return 0;
+}
+
+void sim_simulator_free(struct SimSimulator *s) {
+  if (s->type == GSHARE || s->type == BIMODAL) {
+    sim_gshare_free(&s->gshare);
+  } else if (s->type == HYBRID) {
+    sim_hybrid_free(&s->hybrid);
+  }
+}
+
+bool sim_simulator_predict_and_update(struct SimSimulator *s,
+                                      struct SimInstruction *i) {
+  if (s->type == SMITH_N_BIT) {
+    return sim_smith_n_bit_predict_and_update(&s->smith_n_bit, i);
+  } else if (s->type == HYBRID) {
+    return sim_hybrid_predict_and_update(&s->hybrid, i);
+  }
+  // GSHARE and BIMODAL share the same predictor.
+  return sim_gshare_predict_and_update(&s->gshare, i);
+}
+
+void sim_simulator_print(struct SimSimulator *s, FILE *f) {
+  if (s->type == SMITH_N_BIT) {
+    sim_smith_n_bit_print(&s->smith_n_bit, f);
+  } else if (s->type == GSHARE || s->type == BIMODAL) {
+    sim_gshare_print(&s->gshare, f);
+  } else if (s->type == HYBRID) {
+    sim_hybrid_print(&s->hybrid, f);
+  }
+}
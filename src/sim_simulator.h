@@ -1,6 +1,72 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include "sim_gshare.h"
+#include "sim_hybrid.h"
 #include "sim_parser.h"
+#include "sim_smith_n_bit.h"
 
+enum SimSimulationType {
+  SMITH_N_BIT = 1,
+  GSHARE = 2,
+  BIMODAL = 3,
+  HYBRID = 4,
+};
+
+struct SimArgs {
+  enum SimSimulationType type;
+  uint64_t counter_bits;
+  uint64_t chooser_bits;
+  uint64_t pc_bits_1;
+  uint64_t pc_bits_2;
+  uint64_t gbhr_bits;
+  char *tracefile;
+};
+
+/**
+ * SimSimulator dispatches to the branch predictor selected by SimArgs.
+ * @var type Branch predictor in use. Only the matching member is initialized.
+ */
+struct SimSimulator {
+  enum SimSimulationType type;
+  struct SimSmithNBit smith_n_bit;
+  struct SimGshare gshare;
+  struct SimHybrid hybrid;
+};
+
+/**
+ * Parse command line arguments.
+ * A valid command line usage will identify simulator type as the first
+ * argument. Additional arguments depend on the simulator type and always end
+ * with the trace file.
+ * @param[in]  argc Argument count, including the program name.
+ * @param[in]  argv Arguments, argv[0] being the program name.
+ * @param[in]  f File to report errors to. May be NULL.
+ * @param[out] args Parsed arguments.
+ * @return 0 if arguments are valid.
+ *        -1 otherwise.
+ */
+int sim_simulator_parse_args(int argc, char *argv[], FILE *f,
+                             struct SimArgs *args);
+
+/**
+ * Format the simulator type and its parameters the way they are passed on the
+ * command line, e.g. "gshare 9 3".
+ * @param[in]  args Parsed arguments.
+ * @param[out] str Output buffer.
+ * @param[in]  size Size of the output buffer.
+ */
+void sim_simulator_format_args(struct SimArgs *args, char *str, size_t size);
+
+/**
+ * Initialize the branch predictor described by args.
+ * @return 0 if initialization is successful.
+ *        -1 if the simulation type is invalid or memory allocation fails.
+ */
+int sim_simulator_init(struct SimSimulator *s, struct SimArgs *args);
+void sim_simulator_free(struct SimSimulator *s);
+bool sim_simulator_predict_and_update(struct SimSimulator *s,
+                                      struct SimInstruction *i);
+void sim_simulator_print(struct SimSimulator *s, FILE *f);
@@ -0,0 +1,203 @@
+#include "sim_thread_pool.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// SimJobQueue is a queue of jobs owned by a single worker, ordered by
+// decreasing cost. Jobs between head and tail are pending. Dependents are
+// pushed in front of head, so head starts past room for all of them.
+struct SimJobQueue {
+  pthread_mutex_t lock;
+  struct SimJob **jobs;
+  size_t head;
+  size_t tail;
+};
+
+// SimThreadPool tracks the jobs that have not finished yet. generation changes
+// whenever dependents are queued, so that idle workers know when to look again.
+struct SimThreadPool {
+  pthread_mutex_t lock;
+  pthread_cond_t changed;
+  size_t pending;
+  uint64_t generation;
+  size_t threads;
+  struct SimJobQueue *queues;
+};
+
+struct SimWorker {
+  size_t id;
+  struct SimThreadPool *pool;
+  pthread_t thread;
+};
+
+static int sim_job_compare_cost(const void *a, const void *b) {
+  const struct SimJob *ja = *(struct SimJob *const *)a;
+  const struct SimJob *jb = *(struct SimJob *const *)b;
+  if (ja->cost > jb->cost) {
+    return -1;
+  } else if (ja->cost < jb->cost) {
+    return 1;
+  }
+  return 0;
+}
+
+static struct SimJob *sim_job_queue_pop_front(struct SimJobQueue *q) {
+  struct SimJob *job = NULL;
+  pthread_mutex_lock(&q->lock);
+  if (q->head < q->tail) {
+    job = q->jobs[q->head++];
+  }
+  pthread_mutex_unlock(&q->lock);
+  return job;
+}
+
+static void sim_job_queue_push_front(struct SimJobQueue *q,
+                                     struct SimJob **jobs, size_t count) {
+  pthread_mutex_lock(&q->lock);
+  q->head -= count;
+  for (size_t i = 0; i < count; i++) {
+    q->jobs[q->head + i] = jobs[i];
+  }
+  qsort(q->jobs + q->head, count, sizeof(struct SimJob *),
+        sim_job_compare_cost);
+  pthread_mutex_unlock(&q->lock);
+}
+
+static void *sim_worker_run(void *arg) {
+  struct SimWorker *w = arg;
+  struct SimThreadPool *pool = w->pool;
+  while (true) {
+    pthread_mutex_lock(&pool->lock);
+    uint64_t generation = pool->generation;
+    bool done = pool->pending == 0;
+    pthread_mutex_unlock(&pool->lock);
+    if (done) {
+      return NULL;
+    }
+
+    struct SimJob *job = sim_job_queue_pop_front(&pool->queues[w->id]);
+    for (size_t i = 1; job == NULL && i < pool->threads; i++) {
+      job = sim_job_queue_pop_front(
+          &pool->queues[(w->id + i) % pool->threads]);
+    }
+    if (job == NULL) {
+      // Every queue was empty, but running jobs may still queue dependents.
+      pthread_mutex_lock(&pool->lock);
+      while (pool->generation == generation && pool->pending > 0) {
+        pthread_cond_wait(&pool->changed, &pool->lock);
+      }
+      pthread_mutex_unlock(&pool->lock);
+      continue;
+    }
+
+    job->run(job->arg);
+    if (job->dependents_size > 0) {
+      sim_job_queue_push_front(&pool->queues[w->id], job->dependents,
+                               job->dependents_size);
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->pending--;
+    if (job->dependents_size > 0 || pool->pending == 0) {
+      pool->generation++;
+      pthread_cond_broadcast(&pool->changed);
+    }
+    pthread_mutex_unlock(&pool->lock);
+  }
+}
+
+int sim_thread_pool_run(struct SimJob *jobs, size_t count, size_t threads) {
+  if (count == 0) {
+    return 0;
+  }
+  if (threads == 0) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = cpus > 0 ? (size_t)cpus : 1;
+  }
+  if (threads > count) {
+    threads = count;
+  }
+
+  bool *is_dependent = calloc(count, sizeof(bool));
+  struct SimJob **roots = malloc(count * sizeof(struct SimJob *));
+  if (is_dependent == NULL || roots == NULL) {
+    free(is_dependent);
+    free(roots);
+    return -1;
+  }
+  size_t dependents = 0;
+  for (size_t i = 0; i < count; i++) {
+    for (size_t d = 0; d < jobs[i].dependents_size; d++) {
+      is_dependent[jobs[i].dependents[d] - jobs] = true;
+    }
+    dependents += jobs[i].dependents_size;
+  }
+  size_t roots_size = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (!is_dependent[i]) {
+      roots[roots_size++] = &jobs[i];
+    }
+  }
+  free(is_dependent);
+  qsort(roots, roots_size, sizeof(struct SimJob *), sim_job_compare_cost);
+
+  // Any queue may end up holding every dependent in front of its own share of
+  // the roots.
+  size_t queue_capacity = dependents + roots_size / threads + 1;
+  struct SimThreadPool pool = {.pending = count, .threads = threads};
+  pool.queues = calloc(threads, sizeof(struct SimJobQueue));
+  struct SimWorker *workers = calloc(threads, sizeof(struct SimWorker));
+  struct SimJob **slots = malloc(threads * queue_capacity *
+                                 sizeof(struct SimJob *));
+  if (pool.queues == NULL || workers == NULL || slots == NULL) {
+    free(roots);
+    free(pool.queues);
+    free(workers);
+    free(slots);
+    return -1;
+  }
+
+  // Deal roots round-robin so that each queue is ordered by decreasing cost and
+  // every worker starts with one of the costliest jobs.
+  pthread_mutex_init(&pool.lock, NULL);
+  pthread_cond_init(&pool.changed, NULL);
+  for (size_t t = 0; t < threads; t++) {
+    pthread_mutex_init(&pool.queues[t].lock, NULL);
+    pool.queues[t].jobs = slots + t * queue_capacity;
+    pool.queues[t].head = dependents;
+    pool.queues[t].tail = dependents;
+  }
+  for (size_t i = 0; i < roots_size; i++) {
+    struct SimJobQueue *q = &pool.queues[i % threads];
+    q->jobs[q->tail++] = roots[i];
+  }
+  free(roots);
+
+  size_t started = 0;
+  for (; started < threads; started++) {
+    workers[started].id = started;
+    workers[started].pool = &pool;
+    if (pthread_create(&workers[started].thread, NULL, sim_worker_run,
+                       &workers[started]) != 0) {
+      break;
+    }
+  }
+  // Workers that did start steal whatever a failed one left behind. Drain the
+  // queues on the calling thread if no worker could be started at all.
+  if (started == 0) {
+    sim_worker_run(&workers[0]);
+  }
+  for (size_t t = 0; t < started; t++) {
+    pthread_join(workers[t].thread, NULL);
+  }
+
+  for (size_t t = 0; t < threads; t++) {
+    pthread_mutex_destroy(&pool.queues[t].lock);
+  }
+  pthread_cond_destroy(&pool.changed);
+  pthread_mutex_destroy(&pool.lock);
+  free(pool.queues);
+  free(workers);
+  free(slots);
+  return 0;
+}
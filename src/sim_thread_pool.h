@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * SimJob is a unit of work executed by sim_thread_pool_run.
+ * @var run Function executing the job.
+ * @var arg Argument passed to run.
+ * @var cost Estimated cost of the job. Costlier jobs are started first.
+ * @var dependents Jobs that may only start once this job has finished.
+ * @var dependents_size Number of dependents.
+ */
+struct SimJob {
+  void (*run)(void *arg);
+  void *arg;
+  uint64_t cost;
+  struct SimJob **dependents;
+  size_t dependents_size;
+};
+
+/**
+ * Run all jobs on a work-stealing pool of threads and wait for them to finish.
+ * Jobs that are nobody's dependent are sorted by decreasing cost and dealt
+ * round-robin to the per-thread queues. A thread takes the costliest job from
+ * the front of its own queue and, once that is empty, steals the costliest
+ * pending job from the front of another queue, so jobs keep starting in longest
+ * first order. When a job finishes, its dependents are pushed to the front of
+ * the queue of the thread that ran it, costliest first, so a thread finishes
+ * the work a job unlocked before it starts another of its own jobs.
+ * @param[in] jobs Jobs to run. Dependents must be elements of jobs, and every
+ *            job may be the dependent of at most one other job.
+ * @param[in] count Number of jobs.
+ * @param[in] threads Number of threads. 0 uses the number of online CPUs.
+ * @return 0 if all jobs ran.
+ *        -1 if memory allocation fails.
+ */
+int sim_thread_pool_run(struct SimJob *jobs, size_t count, size_t threads);
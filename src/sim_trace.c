@@ -0,0 +1,78 @@
+#include "sim_trace.h"
+#include "sim_io.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SIM_TRACE_INITIAL_CAPACITY 4096
+
+int sim_trace_load(struct SimTrace *trace, const char *path) {
+  return sim_trace_load_range(trace, path, 0, -1);
+}
+
+int sim_trace_load_range(struct SimTrace *trace, const char *path, off_t offset,
+                         off_t length) {
+  trace->path = strdup(path);
+  trace->instructions = NULL;
+  trace->size = 0;
+  trace->capacity = 0;
+  if (trace->path == NULL) {
+    return -1;
+  }
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    sim_trace_free(trace);
+    return -1;
+  }
+
+  struct SimReadBuf buffer = {.buf = NULL, .fd = fd};
+  struct SimParser parser = {.buf = buffer};
+  if (sim_read_buf_init(&parser.buf, 1 << 16) < 0) {
+    close(fd);
+    sim_trace_free(trace);
+    return -1;
+  }
+  if (sim_read_buf_seek(&parser.buf, offset, length) != 0) {
+    close(fd);
+    sim_read_buf_free(&parser.buf);
+    sim_trace_free(trace);
+    return -1;
+  }
+
+  int status = 0;
+  struct SimInstruction inst;
+  while ((status = sim_parser_next_token(&parser, &inst)) > 0) {
+    if (trace->size == trace->capacity) {
+      size_t capacity = trace->capacity == 0 ? SIM_TRACE_INITIAL_CAPACITY
+                                             : trace->capacity * 2;
+      struct SimInstruction *instructions = realloc(
+          trace->instructions, capacity * sizeof(struct SimInstruction));
+      if (instructions == NULL) {
+        status = -1;
+        break;
+      }
+      trace->instructions = instructions;
+      trace->capacity = capacity;
+    }
+    trace->instructions[trace->size++] = inst;
+  }
+  close(fd);
+  sim_read_buf_free(&parser.buf);
+
+  if (status != 0) {
+    sim_trace_free(trace);
+    return -1;
+  }
+  return 0;
+}
+
+void sim_trace_free(struct SimTrace *trace) {
+  free(trace->path);
+  free(trace->instructions);
+  trace->path = NULL;
+  trace->instructions = NULL;
+  trace->size = 0;
+  trace->capacity = 0;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+#include "sim_parser.h"
+
+/**
+ * SimTrace holds a fully decoded trace file in memory. Once loaded it is only
+ * read, so a single trace can be shared by several simulations at once.
+ * @var path Path of the trace file.
+ * @var instructions Decoded branch instructions in trace order.
+ * @var size Number of decoded instructions.
+ * @var capacity Number of instructions allocated.
+ */
+struct SimTrace {
+  char *path;
+  struct SimInstruction *instructions;
+  size_t size;
+  size_t capacity;
+};
+
+/**
+ * Read and decode the whole trace file.
+ * @param[out] trace Uninitialized SimTrace.
+ * @param[in]  path Path of the trace file.
+ * @return 0 if the trace is successfully loaded.
+ *        -1 if the file cannot be read or memory allocation fails.
+ */
+int sim_trace_load(struct SimTrace *trace, const char *path);
+
+/**
+ * Read and decode length bytes of the trace file starting at offset. The range
+ * should start at the beginning of a line and end right after a newline.
+ * @param[out] trace Uninitialized SimTrace.
+ * @param[in]  path Path of the trace file.
+ * @param[in]  offset Byte offset of the first line to decode.
+ * @param[in]  length Bytes to decode, or -1 to decode until EOF.
+ * @return 0 if the range is successfully loaded.
+ *        -1 if the file cannot be read or memory allocation fails.
+ */
+int sim_trace_load_range(struct SimTrace *trace, const char *path, off_t offset,
+                         off_t length);
+
+/**
+ * Free trace
+ * @param[in] trace Loaded SimTrace.
+ */
+void sim_trace_free(struct SimTrace *trace);